@@ -19,12 +19,14 @@
 namespace cpds {
 
 class Node;
+class FrozenNode;
 
 class Exception : public std::exception
 {
 public:
   explicit Exception(String msg);
   Exception(String msg, const Node& node);
+  Exception(String msg, const FrozenNode& node);
   Exception(String msg, StringPtr filename, int line, int pos);
   virtual const char* what() const noexcept override;
 
@@ -50,6 +52,7 @@ public:
   explicit TypeException(String msg);
   explicit TypeException(const char* msg);
   explicit TypeException(const Node& node);
+  explicit TypeException(const FrozenNode& node);
 }; // class TypeException
 
 class OverflowException : public TypeException
@@ -62,6 +65,7 @@ class KeyException : public Exception
 {
 public:
   KeyException(const String& key, const Node& node);
+  KeyException(const String& key, const FrozenNode& node);
 }; // class KeyException
 
 class ImportException : public Exception
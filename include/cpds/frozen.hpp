@@ -0,0 +1,243 @@
+/*
+ * frozen.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "cpds/node.hpp"
+
+namespace cpds {
+
+class Document;
+
+/**
+ * Read-only handle to a node inside a Document.
+ *
+ * The accessors mirror the const accessors of Node. A handle is only valid
+ * as long as the document it was obtained from.
+ **/
+class FrozenNode
+{
+public:
+  class const_iterator;
+
+  /**
+   * \name Type Information
+   **/
+  //@{
+  NodeType type() const;
+  bool isNull() const { return type() == NodeType::Null; }
+  bool isBool() const { return type() == NodeType::Boolean; }
+  bool isInt() const { return type() == NodeType::Integer; }
+  bool isFloat() const { return type() == NodeType::FloatingPoint; }
+  bool isNumber() const { return (isInt() || isFloat()); }
+  bool isString() const { return type() == NodeType::String; }
+  bool isScalar() const { return !(isSequence() || isMap()); }
+  bool isSequence() const { return type() == NodeType::Sequence; }
+  bool isMap() const { return type() == NodeType::Map; }
+  //@} // Type Information
+
+  /**
+   * \name Data Access
+   **/
+  //@{
+
+  /**
+   * Returns the number of children for Sequence & Map, 0 otherwise.
+   **/
+  std::size_t size() const noexcept;
+  bool empty() const noexcept { return (size() == 0); }
+
+  /**
+   * The same conversion rules as for Node apply.
+   **/
+  bool boolValue() const;
+  Int intValue() const;
+  Float floatValue() const;
+
+  /**
+   * Strings live in the string pool of the document; c_str() provides
+   * access without a copy.
+   **/
+  String stringValue() const;
+  const char* c_str() const;
+  std::size_t length() const;
+
+  /**
+   * Materializes the subtree and applies custom_converter<T>.
+   **/
+  template <typename T>
+  T as() const;
+
+  /**
+   * Children access for Sequences. Throws for other types.
+   *
+   * Throws if the index is out of bounds.
+   **/
+  FrozenNode operator[](std::size_t index) const;
+
+  /**
+   * Children access for Maps. Throws for other types.
+   *
+   * Throws if no entry exists for key.
+   **/
+  FrozenNode operator[](const String& key) const { return at(key); }
+  FrozenNode at(const String& key) const;
+
+  /**
+   * Key lookup for Maps. Throws for other types.
+   **/
+  const_iterator find(const String& key) const;
+
+  /**
+   * Iteration over the children of Sequences and Maps.
+   * sequence() and map() throw for other types. They return a copy of this
+   * handle, such that they can be used on temporaries in range-based loops.
+   **/
+  const_iterator begin() const;
+  const_iterator end() const;
+  FrozenNode sequence() const;
+  FrozenNode map() const;
+  //@} // Data Access
+
+  uint32_t id() const;
+
+  /**
+   * Builds a regular node from this subtree. The node IDs are retained.
+   **/
+  Node thaw() const;
+
+private:
+  friend class Document;
+
+  FrozenNode(const Document* doc, uint32_t index);
+
+  const Document* doc_;
+  uint32_t index_;
+}; // class FrozenNode
+
+/**
+ * Iterator over the children of a frozen Sequence or Map.
+ * For maps, key() returns the key of the current entry. Keys may contain
+ * null characters, keyLength() returns the full length.
+ **/
+class FrozenNode::const_iterator
+{
+public:
+  FrozenNode operator*() const { return FrozenNode(doc_, index_); }
+  const char* key() const;
+  std::size_t keyLength() const;
+
+  const_iterator& operator++() { ++index_; return *this; }
+  bool operator==(const const_iterator& other) const;
+  bool operator!=(const const_iterator& other) const;
+
+private:
+  friend class FrozenNode;
+
+  const_iterator(const Document* doc, uint32_t index);
+
+  const Document* doc_;
+  uint32_t index_;
+}; // class FrozenNode::const_iterator
+
+/**
+ * Immutable, flattened representation of a node tree.
+ *
+ * All nodes are stored in a single tape of fixed-size entries in
+ * breadth-first order, i.e. the children of every container are contiguous
+ * and referenced by offset. Strings and keys live in a shared string pool.
+ * This avoids the per-container heap allocations of Node and is well suited
+ * for data that is not modified after loading.
+ **/
+class Document
+{
+public:
+  explicit Document(const Node& node);
+
+  FrozenNode root() const { return FrozenNode(this, 0); }
+
+  /**
+   * Returns the number of bytes allocated for the tape and the pool.
+   **/
+  std::size_t memoryUsage() const;
+
+private:
+  friend class FrozenNode;
+
+  struct StringRef
+  {
+    uint32_t offset;
+    uint32_t length;
+  }; // struct StringRef
+
+  struct ChildRange
+  {
+    uint32_t first;
+    uint32_t count;
+  }; // struct ChildRange
+
+  struct Entry
+  {
+    NodeType type;
+    uint32_t id;
+    union
+    {
+      bool bool_;
+      Int int_;
+      Float float_;
+      StringRef str_;
+      ChildRange children_;
+    };
+  }; // struct Entry
+
+  StringRef addString(const String& str);
+
+  const Entry& entry(uint32_t index) const { return tape_[index]; }
+  const char* string(StringRef ref) const { return pool_.data() + ref.offset; }
+
+  std::vector<Entry> tape_;
+  std::vector<StringRef> keys_; // only used for the children of maps
+  std::vector<char> pool_;
+}; // class Document
+
+//
+// inline implementations
+//
+
+template <typename T>
+T FrozenNode::as() const
+{
+  return custom_converter<T>::transform(thaw());
+}
+
+inline NodeType FrozenNode::type() const
+{
+  return doc_->entry(index_).type;
+}
+
+inline uint32_t FrozenNode::id() const
+{
+  return doc_->entry(index_).id;
+}
+
+inline bool FrozenNode::const_iterator::operator==(
+    const const_iterator& other) const
+{
+  return (doc_ == other.doc_ && index_ == other.index_);
+}
+
+inline bool FrozenNode::const_iterator::operator!=(
+    const const_iterator& other) const
+{
+  return !operator==(other);
+}
+
+} // namespace cpds
@@ -18,6 +18,11 @@
 
 namespace cpds {
 
+namespace detail {
+class WriteBuffer;
+class FragmentCache;
+} // namespace detail
+
 /**
  * Exports the data structure into JSON format.
  *
@@ -31,32 +36,181 @@ namespace cpds {
 class JsonExport
 {
 public:
+  JsonExport();
+  JsonExport(const JsonExport& other); // the cache is not copied
+  JsonExport& operator=(const JsonExport& other);
+  ~JsonExport();
+
   void dump(std::ostream& strm, const Node& node);
   String dump(const Node& node);
 
+  /**
+   * Writes to a POSIX file descriptor, in large blocks and without the
+   * buffering of std::ostream. Throws if writing fails.
+   **/
+  void dumpToFd(int fd, const Node& node);
+
+  /**
+   * Writes to the file at path, which is created or truncated.
+   *
+   * With atomic, the output is written to a temporary file next to the
+   * target, synced to disk and renamed over the target. Readers, including
+   * ones that map the file into memory, then see either the previous or the
+   * complete new content, never a partially written file.
+   **/
+  void dumpToFile(const String& path, const Node& node, bool atomic = false);
+
+  /**
+   * Returns the exact number of bytes dump() produces for the node with the
+   * current settings, without allocating the output.
+   **/
+  std::size_t measure(const Node& node) const;
+
+  /**
+   * Writes the JSON text into the array of the given capacity, without a
+   * terminating null character. Returns the length of the complete text; if
+   * it exceeds the capacity, the array holds the first capacity bytes.
+   *
+   * This method is real-time safe with the default precision of 0: it does
+   * not allocate memory, take locks or perform system calls. Other precisions
+   * format the numbers with the C library. Each number takes up to
+   * precision + 34 bytes of a 256 byte scratch block, precisions above 222
+   * therefore allocate memory. Trees that are nested deeper than 256 levels
+   * are not written completely, for them 0 is returned. Throws if the node is
+   * not a map; the exception allocates memory.
+   **/
+  std::size_t dumpTo(char* data, std::size_t capacity, const Node& node) const;
+
+  /**
+   * Number of significant digits of floating point numbers.
+   * The default of 0 selects the shortest representation that is read back
+   * as the identical value.
+   **/
   unsigned precision() const { return precision_; }
   void setPrecision(unsigned precision) { precision_ = precision; }
 
   unsigned getIndent() const { return indent_; }
   void setIndent(unsigned indent) { indent_ = indent; }
 
+  /**
+   * Number of threads that serialize the children of a large top-level map
+   * (0 selects the hardware concurrency). The output does not depend on the
+   * number of threads.
+   **/
+  unsigned threads() const { return num_threads_; }
+  void setThreads(unsigned num_threads) { num_threads_ = num_threads; }
+
+  /**
+   * Keeps the text of all sequences and maps between calls of dump(), for
+   * repeated exports of the same tree. Only the containers whose revision
+   * changed since the previous export are formatted again, see
+   * Node::revision(). Caching takes precedence over multiple threads.
+   **/
+  bool caching() const { return static_cast<bool>(cache_); }
+  void setCaching(bool enable);
+
 private:
-  void dumpNode(std::ostream& strm, const Node& node);
-  void dumpBoolean(std::ostream& strm, bool value);
-  void dumpInteger(std::ostream& strm, Int value);
-  void dumpFloat(std::ostream& strm, Float value);
-  void dumpString(std::ostream& strm, const String& value);
-  void dumpSequence(std::ostream& strm, const Node& node);
-  void dumpMap(std::ostream& strm, const Node& node);
-
-  void dumpHex(std::ostream& strm, uint16_t value);
-  void dumpOffset(std::ostream& strm);
-
-  unsigned precision_ = 6;
+  void dumpCached(detail::WriteBuffer& buffer, const Node& node);
+  bool isChunked(const Node& node) const;
+  void dumpNode(detail::WriteBuffer& buffer, const Node& node) const;
+
+  unsigned precision_ = 0;
   unsigned indent_ = 0;
-  unsigned offset_ = 0;
+  unsigned num_threads_ = 1;
+  std::unique_ptr<detail::FragmentCache> cache_;
 }; // class JsonExport
 
+/**
+ * Writes JSON incrementally, without building a Node first.
+ *
+ * The output uses the same format as JsonExport. As for JsonExport, the
+ * top-level value must be a map. Map values must be preceded by key().
+ * Calls that would produce invalid JSON throw.
+ *
+ * The output is buffered and flushed in large blocks, once the top-level map
+ * is complete, and on flush(). The destructor flushes any remaining output.
+ **/
+class JsonWriter
+{
+public:
+  /**
+   * Writes to a stream or a POSIX file descriptor.
+   * Indent and precision have the same meaning as for JsonExport.
+   **/
+  explicit JsonWriter(std::ostream& strm, unsigned indent = 0,
+                      unsigned precision = 0);
+  explicit JsonWriter(int fd, unsigned indent = 0, unsigned precision = 0);
+  ~JsonWriter() noexcept;
+
+  JsonWriter(const JsonWriter&) = delete;
+  JsonWriter& operator=(const JsonWriter&) = delete;
+
+  /**
+   * \name Structure
+   **/
+  //@{
+  void beginMap();
+  void endMap();
+  void beginSequence();
+  void endSequence();
+  void key(const String& key);
+  //@} // Structure
+
+  /**
+   * \name Values
+   *
+   * The integer overrides are required to disambiguate literals.
+   * value(const Node&) writes the complete subtree.
+   **/
+  //@{
+  void null();
+  void value(bool value);
+  void value(int value);
+  void value(long int value);
+  void value(long long int value);
+  void value(unsigned int value);
+  void value(unsigned long int value);
+  void value(unsigned long long int value);
+  void value(Float value);
+  void value(const char* value);
+  void value(const String& value);
+  void value(const Node& node);
+  //@} // Values
+
+  /**
+   * Returns true once the top-level map is complete.
+   **/
+  bool complete() const;
+
+  void flush();
+
+private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+}; // class JsonWriter
+
+/**
+ * Receives the content of a JSON document from JsonImport::parse(), in
+ * document order. Each map value is preceded by key().
+ **/
+class JsonHandler
+{
+public:
+  virtual ~JsonHandler() = default;
+
+  virtual void beginMap() = 0;
+  virtual void endMap() = 0;
+  virtual void beginSequence() = 0;
+  virtual void endSequence() = 0;
+  virtual void key(const String& key) = 0;
+
+  virtual void null() = 0;
+  virtual void value(bool value) = 0;
+  virtual void value(Int value) = 0;
+  virtual void value(Float value) = 0;
+  virtual void value(const String& value) = 0;
+}; // class JsonHandler
+
 class JsonImport
 {
 public:
@@ -64,6 +218,13 @@ public:
   Node load(const String& str);
   Node loadFromFile(const String& str);
 
+  /**
+   * Passes the next JSON object of the stream to the handler, without
+   * creating nodes. No parse info is recorded for the values; as with
+   * load(), the parse info is cleared if the stream differs from the last.
+   **/
+  void parse(std::istream& strm, JsonHandler& handler);
+
   /**
    * Returns the parse info structure associated with the last parse action
    **/
@@ -71,16 +232,18 @@ public:
 
 private:
   Node load(std::istream& strm, StringPtr filename);
+  void setStream(std::istream& strm, StringPtr filename);
 
   Node loadValue();
+  String loadKey();
   Node loadNull();
   Node loadTrue();
   Node loadFalse();
   Node loadNumber();
   Node loadString();
-  Node loadSequence();
-  Node loadMap();
 
+  void parseLiteral(const char* literal);
+  bool parseNumber(Int& int_value, Float& float_value);
   String parseString();
   uint16_t parseCharacter();
 
@@ -178,6 +178,39 @@ public:
    **/
   uint32_t id() const { return id_; }
 
+  /**
+   * Returns the revision of a Sequence or Map, or 0 for other types.
+   *
+   * A new revision is assigned whenever the container is created or handed
+   * out for modification, i.e. by all non-const accessors and merge(). The
+   * const accessors do not change it, use them for reading. Revisions are
+   * unique among all containers.
+   *
+   * The revision does not reflect modifications of nested containers, which
+   * have revisions of their own, nor modifications through references
+   * obtained earlier. After modifying a container through such a reference,
+   * call touch() on it; exporters that cache the output of containers would
+   * not notice the modification otherwise.
+   **/
+  uint64_t revision() const noexcept;
+  void touch() noexcept;
+
+  /**
+   * Returns a node that shares the Sequence or Map of this node instead of
+   * copying it, with the same ID. Other types are copied.
+   *
+   * Shared data is immutable: the non-const accessors of a node that shares
+   * its data first detach a private copy (copy-on-write), which in turn
+   * shares the children. Copies of a node with shared data share it as well.
+   * References obtained through non-const accessors before the call must
+   * not be used to modify the data afterwards.
+   *
+   * The const accessors never detach, such that concurrent lookups through
+   * const references are safe.
+   **/
+  Node share() const;
+  bool isShared() const noexcept;
+
   /**
    * Merges the other node into this node.
    *
@@ -195,13 +228,44 @@ public:
    **/
   void merge(const Node& other);
 
+  /**
+   * Merges all other nodes into this node in a single pass.
+   *
+   * The result is identical to calling merge() for each of the other nodes
+   * in order, i.e. later nodes take precedence. Each key / index of the
+   * result is only produced once, instead of re-walking the accumulated tree
+   * for every layer. If this node is among the other nodes, its state prior
+   * to the merge is used.
+   *
+   * The children of this node are merged on up to num_threads threads
+   * (0 selects the hardware concurrency) if this node holds a large
+   * sequence or map.
+   *
+   * This method provides only the basic exception guarantee.
+   **/
+  void merge(const std::vector<const Node*>& others, unsigned num_threads = 1);
+
+  /**
+   * Hands the data of this node to Reclaimer::global(), which destroys it on
+   * a background thread. This node is null afterwards.
+   *
+   * Use this to drop large trees from latency-critical threads.
+   **/
+  void releaseAsync();
+
   void swap(Node& other) noexcept;
 
   friend bool operator==(const Node& lhs, const Node& rhs) noexcept;
 
 private:
+  friend class FrozenNode; // restores the IDs when thawing
 
   static std::atomic<uint32_t> s_id_;
+  static std::atomic<uint64_t> s_revision_;
+
+  // sequences and maps are allocated together with their revision
+  template <typename Container>
+  struct Tracked;
 
   union Storage
   {
@@ -217,6 +281,10 @@ private:
 
   uint32_t _nextId() const;
 
+  std::atomic<uint32_t>& refCount() const noexcept; // of sequences and maps
+  void detach(); // gives this node a private copy of shared data
+  bool release() noexcept; // returns whether the data is owned exclusively
+
   bool _bool() const;
   Int _int() const;
   Float _float() const;
@@ -229,8 +297,50 @@ private:
 
   void checkValue(unsigned long long int value);
 
-  void mergeSequence(const Node& other);
-  void mergeMap(const Node& other);
+  // placeholder for children that are filled in later on, no ID is assigned
+  struct Shell {};
+  explicit Node(Shell) noexcept;
+
+  // the tree operations use explicit stacks instead of recursion, such that
+  // deeply nested trees do not overflow the call stack
+  using PendingCopies = std::vector<std::pair<Node*, const Node*>>;
+  using PendingMerges = std::vector<std::pair<Node*, const Node*>>;
+  using PendingComparisons = std::vector<std::pair<const Node*, const Node*>>;
+
+  // a child of a layered merge result and the layers that contribute to it
+  struct MergeJob
+  {
+    Node* target;      // the child in the result
+    bool has_base;     // whether the child already exists in the result
+    std::size_t first; // first contributing layer in the source list
+    std::size_t count; // number of contributing layers
+    std::size_t index; // child index, until the target is stable
+  }; // struct MergeJob
+
+  void clear() noexcept;
+  bool hasNestedContainers() const noexcept;
+  void releaseTree() noexcept;
+
+  void copyTree(const Node& other);
+  void copyShallow(const Node& other, PendingCopies& pending);
+
+  void mergeShallow(const Node& other, PendingMerges& pending);
+  void mergeSequence(const Node& other, PendingMerges& pending);
+  void mergeMap(const Node& other, PendingMerges& pending);
+
+  void mergeLayers(const Node* const* layers, std::size_t count,
+                   unsigned num_threads);
+  static void runMergeJobs(std::vector<const Node*>& sources,
+                           std::vector<MergeJob>& jobs);
+  static void mergeStep(Node& target, std::vector<const Node*>& sources,
+                        std::size_t first, std::size_t count,
+                        std::vector<MergeJob>& jobs);
+
+  static bool equalShallow(const Node& lhs, const Node& rhs,
+                           PendingComparisons& pending);
+  static bool equalChild(const Node& lhs, const Node& rhs,
+                         PendingComparisons& pending);
+  static bool equalRecursive(const Node& lhs, const Node& rhs) noexcept;
 
   NodeType type_;
   uint32_t id_;
@@ -319,6 +429,13 @@ inline Node::Node(Float value)
   storage_.float_ = value;
 }
 
+inline Node::Node(Shell) noexcept
+  : type_(NodeType::Null)
+  , id_(0)
+  , storage_()
+{
+}
+
 inline Node::Node(const char* value)
   : Node(String(value))
 {
@@ -0,0 +1,180 @@
+/*
+ * overlay.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <functional>
+#include <initializer_list>
+#include "cpds/node.hpp"
+
+namespace cpds {
+
+class OverlayView;
+struct OverlayEntry;
+
+/**
+ * Read-only view of a stack of layers that behaves like the node obtained by
+ * merging all layers (see Node::merge()), without building the merged copy.
+ *
+ * The layers are ordered from lowest to highest precedence. The view only
+ * stores pointers; the layers must outlive the view and must not be modified
+ * while it is in use. As the layers are only read, concurrent use of views
+ * does not require locking.
+ *
+ * The constructor throws if the layers cannot be merged.
+ **/
+class OverlayView
+{
+public:
+  class const_iterator;
+
+  explicit OverlayView(const Node& node);
+  explicit OverlayView(std::vector<const Node*> layers);
+  OverlayView(std::initializer_list<std::reference_wrapper<const Node>> layers);
+
+  /**
+   * \name Type Information
+   **/
+  //@{
+  NodeType type() const { return top().type(); }
+  bool isNull() const { return top().isNull(); }
+  bool isBool() const { return top().isBool(); }
+  bool isInt() const { return top().isInt(); }
+  bool isFloat() const { return top().isFloat(); }
+  bool isNumber() const { return top().isNumber(); }
+  bool isString() const { return top().isString(); }
+  bool isScalar() const { return top().isScalar(); }
+  bool isSequence() const { return top().isSequence(); }
+  bool isMap() const { return top().isMap(); }
+  //@} // Type Information
+
+  /**
+   * \name Data Access
+   *
+   * The semantics match the const accessors of Node.
+   **/
+  //@{
+
+  /**
+   * Returns the size of the merged Sequence or Map.
+   * For maps, this requires a walk over the keys of all layers.
+   **/
+  std::size_t size() const;
+  bool empty() const { return (size() == 0); }
+
+  bool boolValue() const { return top().boolValue(); }
+  Int intValue() const { return top().intValue(); }
+  Float floatValue() const { return top().floatValue(); }
+  const String& stringValue() const { return top().stringValue(); }
+
+  /**
+   * Scalars are converted directly, sequences and maps are materialized
+   * before the conversion.
+   **/
+  template <typename T>
+  T as() const;
+
+  /**
+   * Children access for Sequences. Throws for other types.
+   *
+   * Throws if the index is out of bounds.
+   **/
+  OverlayView operator[](std::size_t index) const;
+
+  /**
+   * Children access for Maps. Throws for other types.
+   *
+   * Throws if no entry exists for key.
+   **/
+  OverlayView operator[](const String& key) const { return at(key); }
+  OverlayView at(const String& key) const;
+
+  /**
+   * Key lookup and iteration in key order for Maps. Throws for other types.
+   **/
+  const_iterator find(const String& key) const;
+  const_iterator begin() const;
+  const_iterator end() const;
+  //@} // Data Access
+
+  /**
+   * Returns the layer with the highest precedence.
+   **/
+  const Node& top() const { return *layers_.back(); }
+  const std::vector<const Node*>& layers() const { return layers_; }
+
+  /**
+   * Builds the merged node.
+   **/
+  Node materialize() const;
+
+private:
+  void init();
+
+  std::vector<const Node*> layers_;
+}; // class OverlayView
+
+/**
+ * Map entry as seen through an overlay view.
+ **/
+struct OverlayEntry
+{
+  const String& first;
+  OverlayView second;
+}; // struct OverlayEntry
+
+/**
+ * Forward iterator over the merged map entries in key order.
+ * The iterator refers to the view it was obtained from and must not outlive it.
+ **/
+class OverlayView::const_iterator
+{
+public:
+  OverlayEntry operator*() const;
+  const String& key() const { return *key_; }
+  OverlayView value() const;
+
+  const_iterator& operator++();
+  bool operator==(const const_iterator& other) const;
+  bool operator!=(const const_iterator& other) const;
+
+private:
+  friend class OverlayView;
+
+  const_iterator(const std::vector<const Node*>* layers,
+                 std::vector<Map::const_iterator> positions);
+  void update();
+
+  const std::vector<const Node*>* layers_;
+  std::vector<Map::const_iterator> positions_;
+  const String* key_; // nullptr at the end
+}; // class OverlayView::const_iterator
+
+//
+// inline implementations
+//
+
+template <typename T>
+T OverlayView::as() const
+{
+  if (isScalar())
+  {
+    return top().as<T>();
+  }
+  return materialize().as<T>();
+}
+
+inline bool OverlayView::const_iterator::operator!=(
+    const const_iterator& other) const
+{
+  return !operator==(other);
+}
+
+} // namespace cpds
@@ -0,0 +1,90 @@
+/*
+ * reclaimer.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "cpds/node.hpp"
+
+namespace cpds {
+
+/**
+ * Destroys retired node trees away from the latency-critical path.
+ *
+ * In background mode, a worker thread owned by the reclaimer destroys the
+ * retired trees in batches. In deferred mode, the retired trees are kept until
+ * collect() is called, e.g. at a convenient point of a control loop or from a
+ * low-priority thread.
+ *
+ * Retiring a tree only moves the root node into a list. Once the list has
+ * grown to its steady-state size, retiring does not allocate memory.
+ **/
+class Reclaimer
+{
+public:
+  enum class Mode
+  {
+    Background,
+    Deferred,
+  }; // enum class Mode
+
+  explicit Reclaimer(Mode mode = Mode::Background);
+  ~Reclaimer(); // destroys all pending trees
+
+  Reclaimer(const Reclaimer&) = delete;
+  Reclaimer& operator=(const Reclaimer&) = delete;
+
+  Mode mode() const { return mode_; }
+
+  /**
+   * Takes over the data of the node. The node is null afterwards.
+   **/
+  void retire(Node&& node);
+
+  /**
+   * Destroys all pending trees on the calling thread.
+   * Returns the number of trees destroyed.
+   **/
+  std::size_t collect();
+
+  /**
+   * Returns once all trees retired so far are destroyed.
+   * In deferred mode, this is the same as collect().
+   **/
+  void flush();
+
+  /**
+   * Returns the number of retired trees that are not destroyed yet.
+   **/
+  std::size_t pending() const;
+
+  /**
+   * The reclaimer in background mode used by Node::releaseAsync().
+   **/
+  static Reclaimer& global();
+
+private:
+  void run();
+
+  Mode mode_;
+  mutable std::mutex mutex_;
+  std::condition_variable wakeup_; // signals new work to the worker
+  std::condition_variable done_;   // signals completed batches
+  std::vector<Node> pending_;
+  std::vector<Node> spare_; // keeps the capacity of the last batch
+  std::size_t num_retired_ = 0;
+  std::size_t num_reclaimed_ = 0;
+  bool stop_ = false;
+  std::thread thread_;
+}; // class Reclaimer
+
+} // namespace cpds
@@ -0,0 +1,45 @@
+/*
+ * transcode.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <istream>
+#include <ostream>
+
+namespace cpds {
+
+/**
+ * Converts the next JSON object of the input into a YAML document.
+ *
+ * The parser passes the content directly to the writer, no Node tree is
+ * built. The output is the one of YamlExport::dump() for the tree that
+ * JsonImport::load() would return, except that the map keys keep the order
+ * of the input instead of being sorted.
+ *
+ * Throws ImportException on syntax errors. The output may be incomplete then.
+ **/
+void jsonToYaml(std::istream& in, std::ostream& out);
+
+/**
+ * Converts the first document of the YAML input into JSON, without building
+ * a Node tree. Indent and precision have the same meaning as for JsonExport.
+ *
+ * The scalars are resolved as by YamlImport, and the output is the one of
+ * JsonExport for the imported tree, except that the map keys keep the order
+ * of the input. Aliases repeat the content of their anchor, only anchored
+ * subtrees are recorded for this purpose.
+ *
+ * Throws ImportException on syntax errors, and TypeException if the document
+ * is not a map. The output may be incomplete then.
+ **/
+void yamlToJson(std::istream& in, std::ostream& out, unsigned indent = 0,
+                unsigned precision = 0);
+
+} // namespace cpds
@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <exception>
 #include "cpds/typedefs.hpp"
 
 namespace cpds {
@@ -45,6 +46,67 @@ enum GroupEnableResult
   Check,   ///< Perform the group member check
 }; // enum GroupEnableResult
 
+/**
+ * Outcome of Validator::check().
+ *
+ * A failed check records the first failure, which is only turned into a
+ * message or an exception on request. The failing node is referenced, such
+ * that the result must not outlive the validated tree.
+ **/
+class ValidationResult
+{
+public:
+  enum class Error
+  {
+    None,
+    Type,       ///< the node has the wrong type
+    IntRange,   ///< the integer is out of range
+    FloatRange, ///< the floating point number is out of range
+    Validation, ///< other failure of a built-in validator
+    Exception,  ///< a custom function threw, see exception()
+  }; // enum class Error
+
+  bool valid() const { return error_ == Error::None; }
+  Error error() const { return error_; }
+  const Node* node() const { return node_; }
+  std::exception_ptr exception() const { return exception_; }
+  String message() const;
+
+  /**
+   * Throws the exception that Validator::validate() throws for the failure.
+   **/
+  [[noreturn]] void raise() const;
+
+  void clear();
+
+  /**
+   * \name Reporting
+   * Record the failure and return false, such that a check can end with
+   * e.g. return result.typeError(node). The message must be a literal.
+   **/
+  //@{
+  bool typeError(const Node& node);
+  bool intRangeError(Int min, Int max, Int actual, const Node& node);
+  bool floatRangeError(Float min, Float max, Float actual, const Node& node);
+  bool failure(const char* msg, const Node& node);
+  bool extraKey(const String& key, const Node& node);
+  bool exceptionError(std::exception_ptr exception);
+  //@} // Reporting
+
+private:
+  Error error_ = Error::None;
+  const Node* node_ = nullptr;
+  const char* msg_ = nullptr;
+  const String* key_ = nullptr; // extra map key
+  Int int_min_ = 0;
+  Int int_max_ = 0;
+  Int int_actual_ = 0;
+  Float float_min_ = 0.0;
+  Float float_max_ = 0.0;
+  Float float_actual_ = 0.0;
+  std::exception_ptr exception_;
+}; // class ValidationResult
+
 /**
  * The validator function shall throw if the node does not validate.
  **/
@@ -80,9 +142,35 @@ public:
   Validator(Validator&& other) noexcept;
   Validator& operator=(Validator other) noexcept;
   ~Validator();
-  void validate(const Node& node) const;
+
+  /**
+   * Throws if the node does not validate.
+   *
+   * The children of large sequences and maps are checked on up to
+   * num_threads threads (0 selects the hardware concurrency). The first
+   * failure cancels the remaining work, and the reported failure is the one
+   * of the lowest index or key, as with a single thread. Custom functions
+   * may then be called concurrently.
+   **/
+  void validate(const Node& node, unsigned num_threads = 1) const;
+
+  /**
+   * Returns whether the node validates. The built-in validators report
+   * failures without exceptions; custom functions that throw are recorded
+   * as ValidationResult::Error::Exception. See validate() for num_threads.
+   **/
+  bool check(const Node& node, ValidationResult& result,
+             unsigned num_threads = 1) const;
+
   NodeType type() const { return type_; }
   ValidationFcn validationFcn() const { return fcn_; }
+
+  /**
+   * Returns whether the validation function is one of the library, as
+   * opposed to a custom function. The validation data of built-in
+   * validators is available through the accessors below.
+   **/
+  bool isBuiltin() const;
   const IntRange& intRange() const;
   const FloatRange& floatRange() const;
   const ValidatorVector& seqValidators() const;
@@ -90,14 +178,18 @@ public:
   void swap(Validator& other) noexcept;
 
 private:
+  struct MapData; // the groups and their discriminator lookup
+
   union Storage {
     IntRange* int_range_;
     FloatRange* float_range_;
     ValidatorVector* seq_validators_;
-    MapGroupVector* map_groups_;
+    MapData* map_data_;
   }; // union Storage
 
   void checkType(NodeType type) const;
+  bool checkMap(const Node& node, ValidationResult& result,
+                unsigned num_threads) const;
 
   NodeType type_;
   ValidationFcn fcn_;
@@ -173,8 +265,11 @@ public:
                Requiredness requiredness);
 
   void validate(const Node& node) const;
+  bool validate(const Node& node, ValidationResult& result) const;
 
   const String& key() const { return key_; }
+  const Validator& validator() const { return validator_; }
+  Requiredness requiredness() const { return requiredness_; }
 
 private:
   String key_;
@@ -182,23 +277,65 @@ private:
   Requiredness requiredness_;
 }; // class MapEntryTpe
 
+/**
+ * Entries that a map must (or may) contain.
+ *
+ * The entries are sorted by key on construction, such that validate()
+ * checks the values, the required keys and, for NoMoreEntries, the absence
+ * of other keys in a single pass over the map.
+ **/
 class MapGroup
 {
 public:
 
   MapGroup(MapEntryTypeVector entries,
            Closedness closedness=AllowMoreEntries);
+
+  /**
+   * Throws if the enable function is null.
+   **/
   MapGroup(MapEntryTypeVector entries,
            Closedness closedness,
            GroupEnableFcn enable_fcn);
 
+  /**
+   * Group for the maps whose discriminator entry has the given string
+   * value, e.g. "type": "pinhole". A required string entry for the key is
+   * added unless the entries contain the key. MapType selects such groups
+   * with a single lookup per discriminator key, instead of checking all
+   * groups in turn.
+   **/
+  MapGroup(MapEntryTypeVector entries,
+           Closedness closedness,
+           String discriminator_key,
+           String discriminator_value);
+
   GroupEnableResult check(const Node& node) const;
   void validate(const Node& node) const;
+  bool validate(const Node& node, ValidationResult& result,
+                unsigned num_threads = 1) const;
+
+  const MapEntryTypeVector& entries() const { return entries_; }
+  Closedness closedness() const { return closedness_; }
+  GroupEnableFcn enableFcn() const { return enable_fcn_; }
+
+  /**
+   * Whether the group was created with a discriminator, such groups have no
+   * enable function.
+   **/
+  bool hasDiscriminator() const { return has_discriminator_; }
+  const String& discriminatorKey() const { return discriminator_key_; }
+  const String& discriminatorValue() const { return discriminator_value_; }
 
 private:
+  void sortEntries();
+
   MapEntryTypeVector entries_;
   Closedness closedness_;
   GroupEnableFcn enable_fcn_;
+  bool has_discriminator_ = false;
+  String discriminator_key_;
+  String discriminator_value_;
 }; // class MapGroup
 
 class MapType : public Validator
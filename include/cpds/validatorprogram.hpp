@@ -0,0 +1,117 @@
+/*
+ * validatorprogram.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include "cpds/validator.hpp"
+
+namespace cpds {
+
+/**
+ * Validator tree compiled into a flat array of instructions.
+ *
+ * The built-in validators become instructions with their ranges inlined, the
+ * entries of each map group are sorted by key, such that a group is checked
+ * in a single pass over the map. Groups with a discriminator are looked up
+ * by its value. Custom validation and group enable functions are called as
+ * by the Validator.
+ *
+ * A program accepts exactly the nodes its validator accepts, and reports the
+ * same kinds of failures. If a node violates several rules, the one that is
+ * reported may differ. The program keeps a copy of the validator, later
+ * changes to the original do not affect it.
+ **/
+class ValidatorProgram
+{
+public:
+  explicit ValidatorProgram(const Validator& validator);
+  ValidatorProgram(ValidatorProgram&& other) noexcept;
+  ValidatorProgram& operator=(ValidatorProgram&& other) noexcept;
+  ~ValidatorProgram();
+
+  void validate(const Node& node) const;
+  bool check(const Node& node, ValidationResult& result) const;
+
+  /**
+   * Returns the number of instructions.
+   **/
+  std::size_t size() const { return code_.size(); }
+
+private:
+  enum class Op : uint8_t
+  {
+    Type,
+    IntRange,
+    FloatRange,
+    Sequence,
+    Map,
+    Custom,
+  }; // enum class Op
+
+  struct Instruction
+  {
+    Op op;
+    NodeType type;
+    uint32_t begin; // first alternative or group
+    uint32_t count; // number of alternatives or groups
+    uint32_t dispatch_begin; // first discriminator table of a map
+    uint32_t dispatch_count;
+    Int int_min;
+    Int int_max;
+    Float float_min;
+    Float float_max;
+    const Validator* validator; // custom validation function
+  }; // struct Instruction
+
+  struct Group
+  {
+    uint32_t begin; // first entry
+    uint32_t count; // number of entries
+    Closedness closedness;
+    GroupEnableFcn enable_fcn;
+  }; // struct Group
+
+  struct Entry
+  {
+    String key;
+    Requiredness requiredness;
+    uint32_t pc; // validator of the value
+  }; // struct Entry
+
+  // groups with the same discriminator key, by discriminator value
+  struct Dispatch
+  {
+    String key;
+    std::unordered_map<String, std::vector<uint32_t>> groups;
+  }; // struct Dispatch
+
+  uint32_t compile(const Validator& validator);
+  void compileMap(uint32_t pc, const MapGroupVector& map_groups);
+
+  bool run(uint32_t pc, const Node& node, ValidationResult& result) const;
+  bool runSequence(const Instruction& ins, const Node& node,
+                   ValidationResult& result) const;
+  bool runMap(const Instruction& ins, const Node& node,
+              ValidationResult& result) const;
+  bool runGroup(const Group& group, const Node& node,
+                ValidationResult& result) const;
+
+  std::unique_ptr<Validator> validator_; // referenced by custom instructions
+  std::vector<Instruction> code_;
+  std::vector<uint32_t> alternatives_; // of the sequences
+  std::vector<Group> groups_;
+  std::vector<Entry> entries_;
+  std::vector<Dispatch> dispatch_;
+}; // class ValidatorProgram
+
+} // namespace cpds
@@ -0,0 +1,182 @@
+/*
+ * walker.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <vector>
+#include "cpds/node.hpp"
+
+namespace cpds {
+
+/**
+ * Depth-first traversal of a node tree in document order.
+ *
+ * The traversal uses an explicit stack instead of recursion, i.e. the call
+ * stack usage does not depend on the nesting depth of the tree.
+ *
+ * The visitor must provide the following methods:
+ * - void scalar(const Node& node);
+ * - void beginSequence(const Node& node);
+ * - void element(std::size_t index); // before each sequence child
+ * - void endSequence(const Node& node);
+ * - void beginMap(const Node& node);
+ * - void key(const String& key, std::size_t index); // before each map child
+ * - void endMap(const Node& node);
+ *
+ * The tree must not be modified during the traversal.
+ **/
+template <typename Visitor>
+void walk(const Node& node, Visitor& visitor);
+
+//
+// inline implementations
+//
+
+namespace detail {
+
+// nesting depth supported by the allocation-free exports
+constexpr std::size_t k_max_bounded_depth = 256;
+
+struct WalkFrame
+{
+  const Node* node;
+  std::size_t index; // next child to visit
+}; // struct WalkFrame
+
+// stack of walk() that grows on demand
+class DynamicWalkStack
+{
+public:
+  bool push(const Node* node)
+  {
+    frames_.push_back(WalkFrame{node, 0});
+    return true;
+  }
+  void pop() { frames_.pop_back(); }
+  WalkFrame& top() { return frames_.back(); }
+  bool empty() const { return frames_.empty(); }
+
+private:
+  std::vector<WalkFrame> frames_;
+}; // class DynamicWalkStack
+
+// stack of walkBounded() in caller-provided memory
+class FixedWalkStack
+{
+public:
+  FixedWalkStack(WalkFrame* frames, std::size_t capacity)
+    : frames_(frames)
+    , capacity_(capacity)
+  {
+  }
+
+  bool push(const Node* node)
+  {
+    if (size_ == capacity_)
+    {
+      return false;
+    }
+    frames_[size_++] = WalkFrame{node, 0};
+    return true;
+  }
+  void pop() { size_--; }
+  WalkFrame& top() { return frames_[size_-1]; }
+  bool empty() const { return (size_ == 0); }
+
+private:
+  WalkFrame* frames_;
+  std::size_t capacity_;
+  std::size_t size_ = 0;
+}; // class FixedWalkStack
+
+template <typename Stack, typename Visitor>
+bool walkStack(const Node& node, Visitor& visitor, Stack& stack)
+{
+  const Node* cur = &node;
+  while (cur != nullptr)
+  {
+    // enter the current node
+    if (cur->isSequence())
+    {
+      if (!stack.push(cur))
+      {
+        return false;
+      }
+      visitor.beginSequence(*cur);
+    }
+    else if (cur->isMap())
+    {
+      if (!stack.push(cur))
+      {
+        return false;
+      }
+      visitor.beginMap(*cur);
+    }
+    else
+    {
+      visitor.scalar(*cur);
+    }
+
+    // advance to the next child, leaving all completed containers
+    cur = nullptr;
+    while (!stack.empty())
+    {
+      WalkFrame& frame = stack.top();
+      if (frame.node->isSequence())
+      {
+        const Sequence& seq = frame.node->sequence();
+        if (frame.index < seq.size())
+        {
+          visitor.element(frame.index);
+          cur = &seq[frame.index++];
+          break;
+        }
+        visitor.endSequence(*frame.node);
+      }
+      else
+      {
+        const Map& map = frame.node->map();
+        if (frame.index < map.size())
+        {
+          visitor.key(map[frame.index].first, frame.index);
+          cur = &map[frame.index++].second;
+          break;
+        }
+        visitor.endMap(*frame.node);
+      }
+      stack.pop();
+    }
+  }
+  return true;
+}
+
+/**
+ * Same as walk(), but with a stack of capacity frames in caller-provided
+ * memory, such that no memory is allocated. Returns false if the nesting
+ * depth exceeds the capacity, after visiting the nodes up to that point.
+ **/
+template <typename Visitor>
+bool walkBounded(const Node& node, Visitor& visitor, WalkFrame* frames,
+                 std::size_t capacity)
+{
+  FixedWalkStack stack(frames, capacity);
+  return walkStack(node, visitor, stack);
+}
+
+} // namespace detail
+
+template <typename Visitor>
+void walk(const Node& node, Visitor& visitor)
+{
+  detail::DynamicWalkStack stack;
+  detail::walkStack(node, visitor, stack);
+}
+
+} // namespace cpds
@@ -10,35 +10,79 @@
 
 #pragma once
 
+#include <functional>
 #include <ostream>
 #include "cpds/parseinfo.hpp"
 
-namespace YAML {
-  class Emitter;
-  class Node;
-} // namespace YAML
-
 namespace cpds {
 
 class Node;
 
+namespace detail {
+class WriteBuffer;
+} // namespace detail
+
 /**
  * Exports the data structure into YAML format.
+ *
+ * Maps and sequences are written in block style, sequences of numbers in
+ * flow style (e.g. [1, 2.5]). Floating point numbers use the shortest
+ * representation that is read back as the identical value.
  **/
 class YamlExport
 {
 public:
   void dump(std::ostream& strm, const Node& node);
   String dump(const Node& node);
+
+  /**
+   * Writes the YAML text into the array of the given capacity, without a
+   * terminating null character. Returns the length of the complete text; if
+   * it exceeds the capacity, the array holds the first capacity bytes.
+   *
+   * The text is identical to the output of dump().
+   *
+   * This method is real-time safe: it does not allocate memory, take locks
+   * or perform system calls. Trees that are nested deeper than 256 levels
+   * are not written completely, for them 0 is returned. Unlike
+   * JsonExport::dumpTo(), any node is accepted, thus it does not throw.
+   **/
+  std::size_t dumpTo(char* data, std::size_t capacity, const Node& node) const;
+
+  /**
+   * Writes the nodes as a stream of documents, each introduced by '---'.
+   * With more than one thread, the documents are serialized in parallel.
+   **/
+  void dumpAll(std::ostream& strm, const Sequence& documents);
+  String dumpAll(const Sequence& documents);
+
+  /**
+   * Number of threads that serialize the children of a large top-level
+   * sequence or map, or the documents of dumpAll() (0 selects the hardware
+   * concurrency). The output does not depend on the number of threads.
+   **/
+  unsigned threads() const { return num_threads_; }
+  void setThreads(unsigned num_threads) { num_threads_ = num_threads; }
+
 private:
-  void dumpNode(YAML::Emitter& emitter, const Node& node) const;
-  void dumpFloat(YAML::Emitter& emitter, const Node& node) const;
-  void dumpSequence(YAML::Emitter& emitter, const Node& node) const;
-  void dumpMap(YAML::Emitter& emitter, const Node& node) const;
+  void dumpNode(detail::WriteBuffer& buffer, const Node& node) const;
+  void dumpChunked(detail::WriteBuffer& buffer, const Node& node) const;
+  void dumpDocuments(detail::WriteBuffer& buffer,
+                     const Sequence& documents) const;
+
+  unsigned num_threads_ = 1;
 }; // class YamlExport
 
 /**
  * Builds a data model from a YAML file
+ *
+ * The nodes are created directly from the parser events, without an
+ * intermediate YAML::Node tree. load() reads the first document of the
+ * stream, loadAll() and forEachDocument() read all of them. Aliases share
+ * the data of the anchored node, see Node::share().
+ *
+ * Plain scalars are resolved following the Core Schema of YAML 1.2, quoted
+ * scalars are always strings.
  **/
 class YamlImport
 {
@@ -47,23 +91,51 @@ public:
   Node load(const String& str);
   Node loadFromFile(const String& str);
 
+  /**
+   * Reads all documents of a stream that are separated by '---'.
+   *
+   * With more than one thread, the stream is read completely and split at
+   * the document markers, and the documents are parsed in parallel. Streams
+   * with directives (e.g. %YAML) are always parsed sequentially.
+   **/
+  Sequence loadAll(std::istream& strm);
+  Sequence loadAll(const String& str);
+  Sequence loadAllFromFile(const String& str);
+
+  /**
+   * Invokes fcn for each document of the stream, in order. The documents are
+   * parsed one at a time, such that only the current one is kept in memory.
+   * During the call, parseinfo() refers to the current document.
+   **/
+  void forEachDocument(std::istream& strm,
+                       const std::function<void(Node& document)>& fcn);
+
+  /**
+   * Number of threads that parse the documents in loadAll() (0 selects the
+   * hardware concurrency). The result does not depend on the number of
+   * threads.
+   **/
+  unsigned threads() const { return num_threads_; }
+  void setThreads(unsigned num_threads) { num_threads_ = num_threads; }
+
   /**
    * Returns the parse info structure associated with the last parse action
    **/
   const ParseInfo& parseinfo() const { return parseinfo_; }
 
 private:
-  Node load(std::istream& strm, StringPtr filename);
+  class Builder; // creates the nodes from the parser events
 
-  Node transform(const YAML::Node& node);
-  Node doTransform(const YAML::Node& node);
-  Node transformScalar(const YAML::Node& node);
-  Node transformSequence(const YAML::Node& node);
-  Node transformMap(const YAML::Node& node);
+  Node load(std::istream& strm, StringPtr filename);
+  Sequence loadAll(std::istream& strm, StringPtr filename);
+  Sequence loadParallel(std::istream& strm);
+  Sequence parseAll(std::istream& strm);
+  void setStream(std::istream& strm, StringPtr filename);
 
   std::istream* strm_ = nullptr;
   StringPtr filename_;
   ParseInfo parseinfo_;
+  unsigned num_threads_ = 1;
 }; // class YamlImport
 
 } // namespace cpds
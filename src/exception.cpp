@@ -11,6 +11,7 @@
 #include "cpds/exception.hpp"
 #include <limits>
 #include "cpds/node.hpp"
+#include "cpds/frozen.hpp"
 #include "cpds/parseinfo.hpp"
 
 namespace cpds {
@@ -68,6 +69,13 @@ Exception::Exception(String msg, const Node& node)
 {
 }
 
+Exception::Exception(String msg, const FrozenNode& node)
+  : msg_(std::move(msg))
+  , node_id_(node.id())
+  , parsemark_()
+{
+}
+
 Exception::Exception(String msg, StringPtr filename, int line, int pos)
   : msg_(std::move(msg))
   , node_id_(std::numeric_limits<uint32_t>::max())
@@ -104,6 +112,11 @@ TypeException::TypeException(const Node& node)
 {
 }
 
+TypeException::TypeException(const FrozenNode& node)
+  : Exception("data type mismatch", node)
+{
+}
+
 //
 // OverflowException implementation
 //
@@ -122,6 +135,11 @@ KeyException::KeyException(const String& key, const Node& node)
 {
 }
 
+KeyException::KeyException(const String& key, const FrozenNode& node)
+  : Exception(buildKeyMsg(key), node)
+{
+}
+
 //
 // ImportException implementation
 //
@@ -0,0 +1,217 @@
+/*
+ * fragmentcache.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "fragmentcache.hpp"
+#include "jsonformatter.hpp"
+
+namespace cpds {
+namespace detail {
+
+// enforce local linkage
+namespace {
+
+// the storage of a container identifies it for as long as it exists
+inline const void* storageOf(const Node& node)
+{
+  if (node.isSequence())
+  {
+    return &node.sequence();
+  }
+  return &node.map();
+}
+
+} // unnamed namespace
+
+FragmentCache::FragmentCache(unsigned precision, unsigned indent)
+  : precision_(precision)
+  , indent_(indent)
+{
+}
+
+void FragmentCache::dump(WriteBuffer& buffer, const Node& node)
+{
+  generation_++;
+  Fragment& root = update(node);
+  emit(buffer, root);
+  prune();
+}
+
+const Node& FragmentCache::child(const Node& node, std::size_t index)
+{
+  if (node.isSequence())
+  {
+    return node.sequence()[index];
+  }
+  return node.map()[index].second;
+}
+
+bool FragmentCache::isCurrent(const Node& node, const Fragment& fragment)
+{
+  // the revision covers the keys and scalars; the nested containers may be
+  // replaced through references held across exports
+  if (fragment.revision != node.revision() || fragment.size != node.size())
+  {
+    return false;
+  }
+  for (const Slot& slot : fragment.slots)
+  {
+    const Node& nested = child(node, slot.index);
+    if (!(nested.isSequence() || nested.isMap()) ||
+        storageOf(nested) != slot.storage)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+FragmentCache::Fragment& FragmentCache::update(const Node& node)
+{
+  // all containers are compared with their fragment from an explicit
+  // stack, only the changed ones are formatted again
+  PendingFragments pending;
+  Fragment& root = lookup(node, 0, pending);
+  while (!pending.empty())
+  {
+    std::pair<const Node*, Fragment*> entry = pending.back();
+    pending.pop_back();
+    if (isCurrent(*entry.first, *entry.second))
+    {
+      visitChildren(*entry.first, *entry.second, pending);
+    }
+    else
+    {
+      format(*entry.first, *entry.second, pending);
+    }
+  }
+  return root;
+}
+
+void FragmentCache::format(const Node& node, Fragment& fragment,
+                           PendingFragments& pending)
+{
+  fragment.text.clear();
+  fragment.slots.clear();
+
+  WriteBuffer buffer(fragment.text);
+  JsonFormatter<RuntimeStyle> formatter(buffer, precision_, indent_);
+  formatter.setDepth(fragment.depth);
+
+  auto writeChild = [&](const Node& child, std::size_t index)
+  {
+    if (child.isSequence() || child.isMap())
+    {
+      Fragment& child_fragment = lookup(child, fragment.depth + 1,
+                                              pending);
+      fragment.slots.push_back(Slot{buffer.size(), index, storageOf(child),
+                                    &child_fragment});
+      return;
+    }
+    formatter.scalar(child);
+  };
+
+  if (node.isSequence())
+  {
+    const Sequence& seq = node.sequence();
+    formatter.openSequence();
+    for (std::size_t i = 0; i < seq.size(); ++i)
+    {
+      formatter.separate(i);
+      writeChild(seq[i], i);
+    }
+    formatter.closeSequence();
+  }
+  else
+  {
+    const Map& map = node.map();
+    formatter.openMap();
+    for (std::size_t i = 0; i < map.size(); ++i)
+    {
+      formatter.key(map[i].first, i);
+      writeChild(map[i].second, i);
+    }
+    formatter.closeMap();
+  }
+  buffer.flush();
+  fragment.revision = node.revision();
+  fragment.size = node.size();
+}
+
+void FragmentCache::visitChildren(const Node& node, const Fragment& fragment,
+                                  PendingFragments& pending)
+{
+  // the slots already refer to the fragments of the same containers, the
+  // scalars are skipped
+  for (const Slot& slot : fragment.slots)
+  {
+    lookup(child(node, slot.index), fragment.depth + 1, pending);
+  }
+}
+
+FragmentCache::Fragment& FragmentCache::lookup(const Node& node,
+                                               unsigned depth,
+                                               PendingFragments& pending)
+{
+  // the references remain valid when the map grows; shared containers are
+  // only compared once per export
+  Fragment& fragment = fragments_[FragmentKey(storageOf(node), depth)];
+  fragment.depth = depth;
+  if (fragment.generation != generation_)
+  {
+    fragment.generation = generation_;
+    pending.emplace_back(&node, &fragment);
+  }
+  return fragment;
+}
+
+void FragmentCache::emit(WriteBuffer& buffer, Fragment& root)
+{
+  // the text of each fragment is interrupted by its nested containers
+  EmitStack stack;
+  root.generation = generation_;
+  stack.emplace_back(&root, 0);
+  while (!stack.empty())
+  {
+    const Fragment& fragment = *stack.back().first;
+    std::size_t& next_slot = stack.back().second;
+    std::size_t begin = (next_slot == 0) ? 0
+                                         : fragment.slots[next_slot-1].offset;
+    if (next_slot == fragment.slots.size())
+    {
+      buffer.write(fragment.text.data() + begin,
+                   fragment.text.size() - begin);
+      stack.pop_back();
+      continue;
+    }
+
+    const Slot& slot = fragment.slots[next_slot++];
+    buffer.write(fragment.text.data() + begin, slot.offset - begin);
+    slot.child->generation = generation_;
+    stack.emplace_back(slot.child, 0);
+  }
+}
+
+void FragmentCache::prune()
+{
+  for (auto iter = fragments_.begin(); iter != fragments_.end();)
+  {
+    if (iter->second.generation != generation_)
+    {
+      iter = fragments_.erase(iter);
+    }
+    else
+    {
+      ++iter;
+    }
+  }
+}
+
+} // namespace detail
+} // namespace cpds
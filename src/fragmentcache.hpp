@@ -0,0 +1,112 @@
+/*
+ * fragmentcache.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "cpds/node.hpp"
+#include "writebuffer.hpp"
+
+namespace cpds {
+namespace detail {
+
+/**
+ * JSON text of the sequences and maps of a node tree, kept between exports.
+ *
+ * Every container is stored with the text of its own brackets, keys and
+ * scalars. Nested containers are referenced at their position in the text.
+ * An export only formats the containers whose revision changed since the
+ * previous export, see Node::revision(). The scalars of unchanged containers
+ * are not visited at all.
+ *
+ * Since nodes do not know their parents, a modification does not renew the
+ * revisions of the ancestors. Hence an export still visits every container,
+ * and checks that its nested containers are still at their recorded
+ * positions, which catches containers replaced through references held
+ * across exports. This costs a few comparisons per container, compared to
+ * formatting all scalars without the cache.
+ **/
+class FragmentCache
+{
+public:
+  FragmentCache(unsigned precision, unsigned indent);
+
+  FragmentCache(const FragmentCache&) = delete;
+  FragmentCache& operator=(const FragmentCache&) = delete;
+
+  unsigned precision() const { return precision_; }
+  unsigned indent() const { return indent_; }
+
+  /**
+   * Writes the node, which must be a sequence or map.
+   * The fragments of containers that are not part of the node are dropped.
+   **/
+  void dump(WriteBuffer& buffer, const Node& node);
+
+private:
+  struct Fragment;
+
+  // position of a nested container within the text of its parent
+  struct Slot
+  {
+    std::size_t offset;
+    std::size_t index; // of the child within its parent
+    const void* storage; // of the child
+    Fragment* child;
+  }; // struct Slot
+
+  struct Fragment
+  {
+    uint64_t revision = 0; // 0 until formatted
+    unsigned depth = 0;
+    uint64_t generation = 0; // export that used the fragment last
+    std::size_t size = 0; // number of children
+    String text;
+    std::vector<Slot> slots;
+  }; // struct Fragment
+
+  using PendingFragments = std::vector<std::pair<const Node*, Fragment*>>;
+  using EmitStack = std::vector<std::pair<Fragment*, std::size_t>>; // slot
+
+  // shared containers occur at several depths, which differ in indentation
+  using FragmentKey = std::pair<const void*, unsigned>; // storage, depth
+  struct FragmentKeyHash
+  {
+    std::size_t operator()(const FragmentKey& key) const
+    {
+      return std::hash<const void*>()(key.first) ^ key.second;
+    }
+  }; // struct FragmentKeyHash
+  using FragmentMap = std::unordered_map<FragmentKey, Fragment,
+                                         FragmentKeyHash>;
+
+  static const Node& child(const Node& node, std::size_t index);
+  static bool isCurrent(const Node& node, const Fragment& fragment);
+
+  Fragment& update(const Node& node);
+  void format(const Node& node, Fragment& fragment, PendingFragments& pending);
+  void visitChildren(const Node& node, const Fragment& fragment,
+                     PendingFragments& pending);
+  Fragment& lookup(const Node& node, unsigned depth,
+                   PendingFragments& pending);
+  void emit(WriteBuffer& buffer, Fragment& root);
+  void prune();
+
+  unsigned precision_;
+  unsigned indent_;
+  uint64_t generation_ = 0;
+  FragmentMap fragments_; // by container storage and depth
+}; // class FragmentCache
+
+} // namespace detail
+} // namespace cpds
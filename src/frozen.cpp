@@ -0,0 +1,392 @@
+/*
+ * frozen.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "cpds/frozen.hpp"
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include "cpds/exception.hpp"
+
+namespace cpds {
+
+// enforce local linkage
+namespace {
+
+constexpr Int k_max_float_int = (1ull<<53);
+constexpr Int k_min_float_int = -k_max_float_int;
+
+constexpr std::size_t k_max_index = std::numeric_limits<uint32_t>::max();
+
+// compares a pooled string with a key, same ordering as std::string
+inline int compareKey(const char* str, std::size_t length, const String& key)
+{
+  int cmp = std::memcmp(str, key.data(), std::min(length, key.size()));
+  if (cmp != 0)
+  {
+    return cmp;
+  }
+  if (length < key.size())
+  {
+    return -1;
+  }
+  return (length > key.size()) ? 1 : 0;
+}
+
+} // unnamed namespace
+
+//
+// FrozenNode implementation
+//
+
+FrozenNode::FrozenNode(const Document* doc, uint32_t index)
+  : doc_(doc)
+  , index_(index)
+{
+}
+
+std::size_t FrozenNode::size() const noexcept
+{
+  if (isSequence() || isMap())
+  {
+    return doc_->entry(index_).children_.count;
+  }
+  return 0;
+}
+
+bool FrozenNode::boolValue() const
+{
+  if (type() == NodeType::Boolean)
+  {
+    return doc_->entry(index_).bool_;
+  }
+  throw TypeException(*this);
+}
+
+Int FrozenNode::intValue() const
+{
+  if (type() == NodeType::Integer)
+  {
+    return doc_->entry(index_).int_;
+  }
+  throw TypeException(*this);
+}
+
+Float FrozenNode::floatValue() const
+{
+  // the same range restriction as for Node::floatValue() applies
+  const Document::Entry& e = doc_->entry(index_);
+  if (e.type == NodeType::FloatingPoint)
+  {
+    return e.float_;
+  }
+  else if (e.type == NodeType::Integer)
+  {
+    if (e.int_ >= k_min_float_int && e.int_ <= k_max_float_int)
+    {
+      return static_cast<Float>(e.int_);
+    }
+  }
+  throw TypeException(*this);
+}
+
+String FrozenNode::stringValue() const
+{
+  return String(c_str(), length());
+}
+
+const char* FrozenNode::c_str() const
+{
+  if (type() != NodeType::String)
+  {
+    throw TypeException(*this);
+  }
+  return doc_->string(doc_->entry(index_).str_);
+}
+
+std::size_t FrozenNode::length() const
+{
+  if (type() != NodeType::String)
+  {
+    throw TypeException(*this);
+  }
+  return doc_->entry(index_).str_.length;
+}
+
+FrozenNode FrozenNode::operator[](std::size_t index) const
+{
+  sequence(); // throws for other types
+  const Document::ChildRange& range = doc_->entry(index_).children_;
+  if (index >= range.count)
+  {
+    throw KeyException(std::to_string(index), *this);
+  }
+  return FrozenNode(doc_, range.first + index);
+}
+
+FrozenNode FrozenNode::at(const String& key) const
+{
+  const_iterator iter = find(key);
+  if (iter == end())
+  {
+    throw KeyException(key, *this);
+  }
+  return *iter;
+}
+
+FrozenNode::const_iterator FrozenNode::find(const String& key) const
+{
+  map(); // throws for other types
+  const Document::ChildRange& range = doc_->entry(index_).children_;
+
+  // the keys are sorted, as they originate from a Map
+  uint32_t first = range.first;
+  uint32_t count = range.count;
+  while (count > 0)
+  {
+    uint32_t step = count / 2;
+    uint32_t mid = first + step;
+    const Document::StringRef& ref = doc_->keys_[mid];
+    int cmp = compareKey(doc_->string(ref), ref.length, key);
+    if (cmp == 0)
+    {
+      return const_iterator(doc_, mid);
+    }
+    else if (cmp < 0)
+    {
+      first = mid + 1;
+      count -= step + 1;
+    }
+    else
+    {
+      count = step;
+    }
+  }
+  return end();
+}
+
+FrozenNode::const_iterator FrozenNode::begin() const
+{
+  if (!isSequence() && !isMap())
+  {
+    throw TypeException(*this);
+  }
+  return const_iterator(doc_, doc_->entry(index_).children_.first);
+}
+
+FrozenNode::const_iterator FrozenNode::end() const
+{
+  if (!isSequence() && !isMap())
+  {
+    throw TypeException(*this);
+  }
+  const Document::ChildRange& range = doc_->entry(index_).children_;
+  return const_iterator(doc_, range.first + range.count);
+}
+
+FrozenNode FrozenNode::sequence() const
+{
+  if (!isSequence())
+  {
+    throw TypeException(*this);
+  }
+  return *this;
+}
+
+FrozenNode FrozenNode::map() const
+{
+  if (!isMap())
+  {
+    throw TypeException(*this);
+  }
+  return *this;
+}
+
+Node FrozenNode::thaw() const
+{
+  // nested containers are thawed from an explicit stack, such that the
+  // stack usage does not depend on the nesting depth
+  Node root;
+  std::vector<std::pair<Node*, uint32_t>> pending;
+  pending.emplace_back(&root, index_);
+  while (!pending.empty())
+  {
+    Node& node = *pending.back().first;
+    const Document::Entry& e = doc_->entry(pending.back().second);
+    pending.pop_back();
+    switch (e.type)
+    {
+    case NodeType::Null:
+      break;
+    case NodeType::Boolean:
+      node = e.bool_;
+      break;
+    case NodeType::Integer:
+      node = e.int_;
+      break;
+    case NodeType::FloatingPoint:
+      node = e.float_;
+      break;
+    case NodeType::String:
+      node = String(doc_->string(e.str_), e.str_.length);
+      break;
+    case NodeType::Sequence:
+    {
+      node = Sequence(e.children_.count);
+      Sequence& seq = node.sequence();
+      for (uint32_t i = 0; i < e.children_.count; ++i)
+      {
+        pending.emplace_back(&seq[i], e.children_.first + i);
+      }
+      break;
+    }
+    case NodeType::Map:
+    {
+      // the keys may contain null characters
+      Map map;
+      map.reserve(e.children_.count);
+      for (uint32_t i = 0; i < e.children_.count; ++i)
+      {
+        const Document::StringRef& ref = doc_->keys_[e.children_.first + i];
+        map.emplace_back(String(doc_->string(ref), ref.length), Node());
+      }
+      node = std::move(map);
+      Map& children = node.map();
+      for (uint32_t i = 0; i < e.children_.count; ++i)
+      {
+        pending.emplace_back(&children[i].second, e.children_.first + i);
+      }
+      break;
+    }
+    }
+    node.id_ = e.id;
+  }
+  return root;
+}
+
+//
+// FrozenNode::const_iterator implementation
+//
+
+FrozenNode::const_iterator::const_iterator(const Document* doc,
+                                           uint32_t index)
+  : doc_(doc)
+  , index_(index)
+{
+}
+
+const char* FrozenNode::const_iterator::key() const
+{
+  return doc_->string(doc_->keys_[index_]);
+}
+
+std::size_t FrozenNode::const_iterator::keyLength() const
+{
+  return doc_->keys_[index_].length;
+}
+
+//
+// Document implementation
+//
+
+Document::Document(const Node& node)
+{
+  // breadth-first flattening keeps the children of a container contiguous;
+  // sources[i] holds the node that corresponds to tape_[i]
+  std::vector<const Node*> sources;
+  pool_.push_back('\0'); // shared empty string
+
+  auto append = [&](const Node& n, StringRef key)
+  {
+    if (tape_.size() >= k_max_index)
+    {
+      throw Exception("node tree too large to be frozen");
+    }
+
+    Entry e;
+    e.type = n.type();
+    e.id = n.id();
+    e.int_ = 0;
+    switch (n.type())
+    {
+    case NodeType::Boolean:
+      e.bool_ = n.boolValue();
+      break;
+    case NodeType::Integer:
+      e.int_ = n.intValue();
+      break;
+    case NodeType::FloatingPoint:
+      e.float_ = n.floatValue();
+      break;
+    case NodeType::String:
+      e.str_ = addString(n.stringValue());
+      break;
+    default:
+      break;
+    }
+    tape_.push_back(e);
+    keys_.push_back(key);
+    sources.push_back(&n);
+  };
+
+  append(node, StringRef{0, 0});
+  for (std::size_t i = 0; i < sources.size(); ++i)
+  {
+    const Node& n = *sources[i];
+    if (n.isSequence())
+    {
+      tape_[i].children_ = ChildRange{ static_cast<uint32_t>(tape_.size()),
+                                       static_cast<uint32_t>(n.size()) };
+      for (const Node& child : n.sequence())
+      {
+        append(child, StringRef{0, 0});
+      }
+    }
+    else if (n.isMap())
+    {
+      tape_[i].children_ = ChildRange{ static_cast<uint32_t>(tape_.size()),
+                                       static_cast<uint32_t>(n.size()) };
+      for (const MapEntry& entry : n.map())
+      {
+        append(entry.second, addString(entry.first));
+      }
+    }
+  }
+
+  tape_.shrink_to_fit();
+  keys_.shrink_to_fit();
+  pool_.shrink_to_fit();
+}
+
+std::size_t Document::memoryUsage() const
+{
+  return (tape_.capacity() * sizeof(Entry) +
+          keys_.capacity() * sizeof(StringRef) +
+          pool_.capacity());
+}
+
+Document::StringRef Document::addString(const String& str)
+{
+  if (str.empty())
+  {
+    return StringRef{0, 0};
+  }
+  if (pool_.size() + str.size() + 1 > k_max_index)
+  {
+    throw Exception("node tree too large to be frozen");
+  }
+
+  StringRef ref{ static_cast<uint32_t>(pool_.size()),
+                 static_cast<uint32_t>(str.size()) };
+  pool_.insert(pool_.end(), str.begin(), str.end());
+  pool_.push_back('\0');
+  return ref;
+}
+
+} // namespace cpds
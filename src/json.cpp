@@ -11,18 +11,26 @@
 #include "cpds/json.hpp"
 #include <cmath>
 #include <cassert>
+#include <cstring>
 #include <sstream>
 #include <fstream>
-#include <iomanip>
 #include <limits>
 #include "cpds/node.hpp"
 #include "cpds/exception.hpp"
+#include "cpds/walker.hpp"
+#include "fragmentcache.hpp"
+#include "jsonformatter.hpp"
+#include "outputfile.hpp"
+#include "parallel.hpp"
 
 namespace cpds {
 
 // enforce local linkage
 namespace {
 
+// minimum number of top-level children for parallel serialization
+constexpr std::size_t k_parallel_export_threshold = 64;
+
 inline void updateInteger(uint64_t& integer, char c)
 {
   integer *= 10;
@@ -44,12 +52,109 @@ inline bool isWhitespace(char c)
   return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
 }
 
+// container that is being parsed by JsonImport
+struct ImportFrame
+{
+  ParseMark mark;
+  bool is_map;
+  Sequence seq;
+  Map map;
+  String key; // key of the current map entry
+}; // struct ImportFrame
+
+// writes the node without allocating memory
+template <typename Style>
+bool dumpBounded(detail::WriteBuffer& buffer, const Node& node,
+                 unsigned precision, unsigned indent)
+{
+  detail::JsonFormatter<Style> formatter(buffer, precision, indent);
+  detail::WalkFrame frames[detail::k_max_bounded_depth];
+  return detail::walkBounded(node, formatter, frames,
+                             detail::k_max_bounded_depth);
+}
+
+// serializes the children of the top-level map in parallel chunks
+template <typename Style>
+void dumpChunked(detail::WriteBuffer& buffer, const Map& map,
+                 unsigned precision, unsigned indent, unsigned num_threads)
+{
+  detail::JsonFormatter<Style> formatter(buffer, precision, indent);
+  formatter.openMap();
+  detail::parallelChunks(map.size(), num_threads,
+                         [&](std::size_t begin, std::size_t end, String& str)
+  {
+    detail::WriteBuffer chunk(str);
+    detail::JsonFormatter<Style> chunk_formatter(chunk, precision, indent);
+    chunk_formatter.setDepth(1);
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      chunk_formatter.separate(i);
+      chunk_formatter.writeKey(map[i].first.data(), map[i].first.size());
+      walk(map[i].second, chunk_formatter);
+    }
+    chunk.flush();
+  },
+  [&](const std::vector<String>& chunks)
+  {
+    buffer.writeChunks(chunks);
+  });
+  formatter.closeMap();
+}
+
 } // unnamed namespace
 
+//
+// escape table
+//
+
+namespace detail {
+
+const char k_json_escapes[256] = {
+  'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+  'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+   0,   0,  '"',  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  '/',
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0, '\\',  0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+};
+
+} // namespace detail
+
 //
 // JsonExport implementation
 //
 
+JsonExport::JsonExport() = default;
+
+JsonExport::JsonExport(const JsonExport& other)
+  : precision_(other.precision_)
+  , indent_(other.indent_)
+  , num_threads_(other.num_threads_)
+{
+  setCaching(other.caching());
+}
+
+JsonExport& JsonExport::operator=(const JsonExport& other)
+{
+  precision_ = other.precision_;
+  indent_ = other.indent_;
+  num_threads_ = other.num_threads_;
+  setCaching(other.caching());
+  return *this;
+}
+
+JsonExport::~JsonExport() = default;
+
 void JsonExport::dump(std::ostream& strm, const Node& node)
 {
   // JSON always starts with an object (aka Map)
@@ -57,218 +162,438 @@ void JsonExport::dump(std::ostream& strm, const Node& node)
   {
     throw TypeException();
   }
-  offset_ = 0;
-  strm << std::setprecision(precision_);
-  dumpNode(strm, node);
+  detail::WriteBuffer buffer(strm);
+  if (cache_)
+  {
+    dumpCached(buffer, node);
+  }
+  else
+  {
+    dumpNode(buffer, node);
+  }
+  buffer.flush();
 }
 
 String JsonExport::dump(const Node& node)
 {
-  std::stringstream sstrm;
-  dump(sstrm, node);
-  return sstrm.str();
+  if (!node.isMap())
+  {
+    throw TypeException();
+  }
+
+  // the string is allocated once and the output written directly into it,
+  // cached and parallel output is not measured upfront to avoid a full pass
+  String str;
+  if (!cache_ && !isChunked(node))
+  {
+    str.reserve(measure(node));
+  }
+  detail::WriteBuffer buffer(str);
+  if (cache_)
+  {
+    dumpCached(buffer, node);
+  }
+  else
+  {
+    dumpNode(buffer, node);
+  }
+  buffer.flush();
+  return str;
 }
 
-void JsonExport::dumpNode(std::ostream& strm, const Node& node)
+void JsonExport::dumpToFd(int fd, const Node& node)
 {
-  switch (node.type())
+  if (!node.isMap())
+  {
+    throw TypeException();
+  }
+
+  // parallel chunks are handed to writev() as a batch
+  detail::WriteBuffer buffer(fd);
+  if (cache_)
+  {
+    dumpCached(buffer, node);
+  }
+  else
   {
-  case NodeType::Null:
-    strm << "null";
-    break;
-  case NodeType::Boolean:
-    dumpBoolean(strm, node.boolValue());
-    break;
-  case NodeType::Integer:
-    dumpInteger(strm, node.intValue());
-    break;
-  case NodeType::FloatingPoint:
-    dumpFloat(strm, node.floatValue());
-    break;
-  case NodeType::String:
-    dumpString(strm, node.stringValue());
-    break;
-  case NodeType::Sequence:
-    dumpSequence(strm, node);
-    break;
-  case NodeType::Map:
-    dumpMap(strm, node);
-    break;
+    dumpNode(buffer, node);
   }
+  buffer.flush();
 }
 
-inline void JsonExport::dumpBoolean(std::ostream& strm, bool value)
+void JsonExport::dumpToFile(const String& path, const Node& node,
+                            bool atomic)
 {
-  strm << (value ? "true" : "false");
+  if (!node.isMap())
+  {
+    throw TypeException();
+  }
+
+  detail::OutputFile file(path, atomic);
+  dumpToFd(file.fd(), node);
+  file.commit();
 }
 
-inline void JsonExport::dumpInteger(std::ostream& strm, Int value)
+std::size_t JsonExport::measure(const Node& node) const
 {
-  strm << value;
+  if (!node.isMap())
+  {
+    throw TypeException();
+  }
+  detail::WriteBuffer counter;
+  dumpNode(counter, node);
+  return counter.size();
 }
 
-inline void JsonExport::dumpFloat(std::ostream& strm, Float value)
+std::size_t JsonExport::dumpTo(char* data, std::size_t capacity,
+                               const Node& node) const
 {
-  // need to handle +Inf, -Inf, and NaN.
-  if (std::isfinite(value))
+  if (!node.isMap())
   {
-    // always print a fractional part.
-    // this aids identification of floating point numbers when JSON is parsed.
-    // std::modf() does not work correctly for numbers near += infinity.
-    double intpart;
-    strm << value;
-    if (std::modf(value, &intpart) == 0.0 &&
-        intpart < std::numeric_limits<uint64_t>::max())
-    {
-      strm << ".0";
-    }
+    throw TypeException();
+  }
+
+  detail::WriteBuffer buffer(data, capacity);
+  bool is_complete;
+  if (indent_ == 0)
+  {
+    is_complete = dumpBounded<detail::CompactStyle>(buffer, node, precision_,
+                                                    indent_);
   }
-  else if (value == std::numeric_limits<double>::infinity())
+  else
   {
-    strm << std::numeric_limits<double>::max();
+    is_complete = dumpBounded<detail::PrettyStyle>(buffer, node, precision_,
+                                                   indent_);
   }
-  else if (value == -std::numeric_limits<double>::infinity())
+  buffer.flush();
+  return is_complete ? buffer.size() : 0;
+}
+
+void JsonExport::setCaching(bool enable)
+{
+  if (!enable)
   {
-    strm << std::numeric_limits<double>::lowest();
+    cache_.reset();
   }
-  else // NaN
+  else if (!cache_)
   {
-    strm << "null";
+    cache_.reset(new detail::FragmentCache(precision_, indent_));
   }
 }
 
-inline void JsonExport::dumpString(std::ostream& strm, const String& value)
+void JsonExport::dumpCached(detail::WriteBuffer& buffer, const Node& node)
 {
-  strm << '"';
-  for (std::size_t i = 0; i < value.size(); i++)
+  // the cached text is only valid for the settings it was formatted with
+  if (cache_->precision() != precision_ || cache_->indent() != indent_)
   {
-    char c = value[i];
-    if (c == '"')
-    {
-      strm << "\\\"";
-    }
-    else if (c == '\\')
-    {
-      strm << "\\\\";
-    }
-    else if (c == '/')
-    {
-      strm << "\\/";
-    }
-    else if (c == '\b')
-    {
-      strm << "\\b";
-    }
-    else if (c == '\f')
-    {
-      strm << "\\f";
-    }
-    else if (c == '\n')
+    cache_.reset(new detail::FragmentCache(precision_, indent_));
+  }
+  cache_->dump(buffer, node);
+}
+
+bool JsonExport::isChunked(const Node& node) const
+{
+  return (node.size() >= k_parallel_export_threshold &&
+          detail::resolveThreads(num_threads_) > 1);
+}
+
+void JsonExport::dumpNode(detail::WriteBuffer& buffer, const Node& node) const
+{
+  if (isChunked(node))
+  {
+    if (indent_ == 0)
     {
-      strm << "\\n";
+      dumpChunked<detail::CompactStyle>(buffer, node.map(), precision_,
+                                        indent_, num_threads_);
     }
-    else if (c == '\r')
+    else
     {
-      strm << "\\r";
+      dumpChunked<detail::PrettyStyle>(buffer, node.map(), precision_,
+                                       indent_, num_threads_);
     }
-    else if (c == '\t')
+  }
+  else if (indent_ == 0)
+  {
+    detail::JsonFormatter<detail::CompactStyle> formatter(buffer, precision_,
+                                                          indent_);
+    walk(node, formatter);
+  }
+  else
+  {
+    detail::JsonFormatter<detail::PrettyStyle> formatter(buffer, precision_,
+                                                         indent_);
+    walk(node, formatter);
+  }
+}
+
+//
+// JsonWriter implementation
+//
+
+class JsonWriter::Impl
+{
+public:
+  Impl(std::ostream& strm, unsigned indent, unsigned precision)
+    : buffer_(strm)
+    , formatter_(buffer_, precision, indent)
+  {
+  }
+
+  Impl(int fd, unsigned indent, unsigned precision)
+    : buffer_(fd)
+    , formatter_(buffer_, precision, indent)
+  {
+  }
+
+  // checks the call sequence and writes the separator of the next value
+  void beginValue(bool is_map);
+  void endValue();
+
+  void beginContainer(bool is_map);
+  void endContainer(bool is_map);
+  void key(const String& key);
+
+  bool complete() const { return (started_ && stack_.empty()); }
+
+  detail::WriteBuffer buffer_;
+  detail::JsonFormatter<detail::RuntimeStyle> formatter_;
+
+private:
+  struct Frame
+  {
+    bool is_map;
+    bool has_key; // a map key is waiting for its value
+    std::size_t count;
+  }; // struct Frame
+
+  std::vector<Frame> stack_;
+  bool started_ = false;
+}; // class JsonWriter::Impl
+
+void JsonWriter::Impl::beginValue(bool is_map)
+{
+  if (stack_.empty())
+  {
+    if (started_)
     {
-      strm << "\\t";
+      throw Exception("JSON document is already complete");
     }
-    else if (c >= 0 && c < 0x20) // control character
+    // JSON always starts with an object (aka Map)
+    if (!is_map)
     {
-      dumpHex(strm, c);
+      throw TypeException();
     }
-    else
+    started_ = true;
+    return;
+  }
+
+  Frame& frame = stack_.back();
+  if (frame.is_map)
+  {
+    if (!frame.has_key)
     {
-      strm << c;
+      throw Exception("JSON map value without key");
     }
+    frame.has_key = false;
+  }
+  else
+  {
+    formatter_.separate(frame.count++);
   }
-  strm << '"';
 }
 
-void JsonExport::dumpSequence(std::ostream& strm, const Node& node)
+void JsonWriter::Impl::endValue()
 {
-  bool first = true;
-  const Sequence& seq = node.sequence();
+  if (complete())
+  {
+    buffer_.flush();
+  }
+}
 
-  strm << '[';
-  offset_ += indent_;
-  dumpOffset(strm);
-  for (const Node& n: seq)
+void JsonWriter::Impl::beginContainer(bool is_map)
+{
+  beginValue(is_map);
+  if (is_map)
   {
-    if (!first)
-    {
-      strm << ',';
-      dumpOffset(strm);
-    }
-    first = false;
-    dumpNode(strm, n);
+    formatter_.openMap();
   }
-  offset_ -= indent_;
-  dumpOffset(strm);
-  strm << ']';
+  else
+  {
+    formatter_.openSequence();
+  }
+  stack_.push_back(Frame{is_map, false, 0});
 }
 
-void JsonExport::dumpMap(std::ostream& strm, const Node& node)
+void JsonWriter::Impl::endContainer(bool is_map)
 {
-  bool first = true;
-  const Map& map = node.map();
+  if (stack_.empty() || stack_.back().is_map != is_map)
+  {
+    throw Exception(is_map ? "JSON writer is not within a map"
+                           : "JSON writer is not within a sequence");
+  }
+  if (stack_.back().has_key)
+  {
+    throw Exception("JSON map key without value");
+  }
 
-  strm << '{';
-  offset_ += indent_;
-  dumpOffset(strm);
-  for (auto iter = map.cbegin(); iter != map.cend(); ++iter)
+  stack_.pop_back();
+  if (is_map)
   {
-    if (!first)
-    {
-      strm << ',';
-      dumpOffset(strm);
-    }
-    first = false;
-    dumpString(strm, iter->first);
-    strm << ':';
-    if (indent_)
-    {
-      strm << ' ';
-    }
-    dumpNode(strm, iter->second);
+    formatter_.closeMap();
+  }
+  else
+  {
+    formatter_.closeSequence();
+  }
+  endValue();
+}
+
+void JsonWriter::Impl::key(const String& key)
+{
+  if (stack_.empty() || !stack_.back().is_map)
+  {
+    throw Exception("JSON writer is not within a map");
   }
-  offset_ -= indent_;
-  dumpOffset(strm);
 
-  // the trailing bracket of the top-level object goes onto a new line
-  if (indent_ != 0 && offset_ == 0)
+  Frame& frame = stack_.back();
+  if (frame.has_key)
   {
-    strm << '\n';
+    throw Exception("JSON map key without value");
   }
-  strm << '}';
+  formatter_.separate(frame.count++);
+  formatter_.writeKey(key.data(), key.size());
+  frame.has_key = true;
+}
+
+JsonWriter::JsonWriter(std::ostream& strm, unsigned indent, unsigned precision)
+  : impl_(new Impl(strm, indent, precision))
+{
 }
 
-void JsonExport::dumpHex(std::ostream& strm, uint16_t value)
+JsonWriter::JsonWriter(int fd, unsigned indent, unsigned precision)
+  : impl_(new Impl(fd, indent, precision))
 {
-  const char codes[16] = {
-    '0', '1', '2', '3', '4', '5', '6', '7',
-    '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
-  };
-  strm << "\\u";
-  strm << codes[(value >> 12) & 0xf];
-  strm << codes[(value >>  8) & 0xf];
-  strm << codes[(value >>  4) & 0xf];
-  strm << codes[(value >>  0) & 0xf];
 }
 
-void JsonExport::dumpOffset(std::ostream& strm)
+JsonWriter::~JsonWriter() noexcept
 {
-  if (offset_ == 0)
+  try
   {
-    return;
+    impl_->buffer_.flush();
   }
-  strm << '\n';
-  for (unsigned i = 0; i < offset_; i++)
+  catch (...)
+  {
+    // nothing sensible to do in the destructor
+  }
+}
+
+void JsonWriter::beginMap()
+{
+  impl_->beginContainer(true);
+}
+
+void JsonWriter::endMap()
+{
+  impl_->endContainer(true);
+}
+
+void JsonWriter::beginSequence()
+{
+  impl_->beginContainer(false);
+}
+
+void JsonWriter::endSequence()
+{
+  impl_->endContainer(false);
+}
+
+void JsonWriter::key(const String& key)
+{
+  impl_->key(key);
+}
+
+void JsonWriter::null()
+{
+  impl_->beginValue(false);
+  impl_->formatter_.writeNull();
+}
+
+void JsonWriter::value(bool value)
+{
+  impl_->beginValue(false);
+  impl_->formatter_.writeBoolean(value);
+}
+
+void JsonWriter::value(int value)
+{
+  this->value(static_cast<long long int>(value));
+}
+
+void JsonWriter::value(long int value)
+{
+  this->value(static_cast<long long int>(value));
+}
+
+void JsonWriter::value(long long int value)
+{
+  impl_->beginValue(false);
+  impl_->formatter_.writeInteger(value);
+}
+
+void JsonWriter::value(unsigned int value)
+{
+  this->value(static_cast<long long int>(value));
+}
+
+void JsonWriter::value(unsigned long int value)
+{
+  this->value(static_cast<unsigned long long int>(value));
+}
+
+void JsonWriter::value(unsigned long long int value)
+{
+  // same range as for Node
+  if (value > static_cast<unsigned long long int>(
+        std::numeric_limits<long long int>::max()))
   {
-    strm << ' ';
+    throw OverflowException();
   }
+  this->value(static_cast<long long int>(value));
+}
+
+void JsonWriter::value(Float value)
+{
+  impl_->beginValue(false);
+  impl_->formatter_.writeFloat(value);
+}
+
+void JsonWriter::value(const char* value)
+{
+  impl_->beginValue(false);
+  impl_->formatter_.writeString(value, std::strlen(value));
+}
+
+void JsonWriter::value(const String& value)
+{
+  impl_->beginValue(false);
+  impl_->formatter_.writeString(value.data(), value.size());
+}
+
+void JsonWriter::value(const Node& node)
+{
+  impl_->beginValue(node.isMap());
+  walk(node, impl_->formatter_);
+  impl_->endValue();
+}
+
+bool JsonWriter::complete() const
+{
+  return impl_->complete();
+}
+
+void JsonWriter::flush()
+{
+  impl_->buffer_.flush();
 }
 
 //
@@ -294,74 +619,288 @@ Node JsonImport::loadFromFile(const String& filename)
 
 Node JsonImport::load(std::istream& strm, StringPtr filename)
 {
-  // only reset the line and position if the stream changed
-  if (strm_ != &strm)
-  {
-    strm_ = &strm;
-    filename_ = filename;
-    line_ = 1;
-    pos_ = 1;
-    parseinfo_.clear();
-  }
-
+  setStream(strm, filename);
   skipWs();
   if (peek() != '{')
   {
     raise("not a JSON object");
   }
-  return loadMap();
+  return loadValue();
 }
 
-Node JsonImport::loadValue()
+void JsonImport::parse(std::istream& strm, JsonHandler& handler)
 {
-  char c = peek();
-  if (c == '"')
-  {
-    return loadString();
-  }
-  else if (c == '[')
-  {
-    return loadSequence();
-  }
-  else if (c == '{')
-  {
-    return loadMap();
-  }
-  else if (c == 't')
+  setStream(strm, nullptr);
+  skipWs();
+  if (peek() != '{')
   {
-    return loadTrue();
+    raise("not a JSON object");
   }
-  else if (c == 'f')
+
+  // same structure as loadValue(), the stack tells whether each open
+  // container is a map
+  std::vector<bool> stack;
+  while (true)
   {
-    return loadFalse();
+    char c = peek();
+    if (c == '[' || c == '{')
+    {
+      bool is_map = (c == '{');
+      read();
+      skipWs();
+      if (is_map)
+      {
+        handler.beginMap();
+      }
+      else
+      {
+        handler.beginSequence();
+      }
+
+      if (peek() != (is_map ? '}' : ']'))
+      {
+        if (is_map)
+        {
+          handler.key(loadKey());
+        }
+        stack.push_back(is_map);
+        continue; // parse the first child
+      }
+
+      // empty container
+      read();
+      skipWs();
+      if (is_map)
+      {
+        handler.endMap();
+      }
+      else
+      {
+        handler.endSequence();
+      }
+    }
+    else if (c == '"')
+    {
+      handler.value(parseString());
+    }
+    else if (c == 't')
+    {
+      parseLiteral("true");
+      handler.value(true);
+    }
+    else if (c == 'f')
+    {
+      parseLiteral("false");
+      handler.value(false);
+    }
+    else if (c == 'n')
+    {
+      parseLiteral("null");
+      handler.null();
+    }
+    else if (c == '-' || isDigit(c))
+    {
+      Int int_value;
+      Float float_value;
+      if (parseNumber(int_value, float_value))
+      {
+        handler.value(float_value);
+      }
+      else
+      {
+        handler.value(int_value);
+      }
+    }
+    else
+    {
+      raise();
+    }
+
+    // complete all containers that end here
+    while (true)
+    {
+      if (stack.empty())
+      {
+        return;
+      }
+
+      bool is_map = stack.back();
+      c = peek();
+      if (c == ',')
+      {
+        read();
+        skipWs();
+        if (is_map)
+        {
+          handler.key(loadKey());
+        }
+        break; // parse the next child
+      }
+      else if (c != (is_map ? '}' : ']'))
+      {
+        raise();
+      }
+
+      read();
+      skipWs();
+      if (is_map)
+      {
+        handler.endMap();
+      }
+      else
+      {
+        handler.endSequence();
+      }
+      stack.pop_back();
+    }
   }
-  else if (c == 'n')
+}
+
+void JsonImport::setStream(std::istream& strm, StringPtr filename)
+{
+  // only reset the line and position if the stream changed
+  if (strm_ != &strm)
   {
-    return loadNull();
+    strm_ = &strm;
+    filename_ = filename;
+    line_ = 1;
+    pos_ = 1;
+    parseinfo_.clear();
   }
-  else if (c == '-' || isDigit(c))
+}
+
+Node JsonImport::loadValue()
+{
+  // nested containers are parsed with an explicit stack, such that deeply
+  // nested documents do not overflow the call stack
+  std::vector<ImportFrame> stack;
+  while (true)
   {
-    return loadNumber();
+    Node value;
+    char c = peek();
+    if (c == '[' || c == '{')
+    {
+      ImportFrame frame;
+      frame.mark = currentMark();
+      frame.is_map = (c == '{');
+      read();
+      skipWs();
+
+      char close = frame.is_map ? '}' : ']';
+      if (peek() != close)
+      {
+        if (frame.is_map)
+        {
+          frame.key = loadKey();
+        }
+        stack.push_back(std::move(frame));
+        continue; // parse the first child
+      }
+
+      // empty container
+      read();
+      skipWs();
+      if (frame.is_map)
+      {
+        value = Node(Map());
+      }
+      else
+      {
+        value = Node(Sequence());
+      }
+      registerNode(value, std::move(frame.mark));
+    }
+    else if (c == '"')
+    {
+      value = loadString();
+    }
+    else if (c == 't')
+    {
+      value = loadTrue();
+    }
+    else if (c == 'f')
+    {
+      value = loadFalse();
+    }
+    else if (c == 'n')
+    {
+      value = loadNull();
+    }
+    else if (c == '-' || isDigit(c))
+    {
+      value = loadNumber();
+    }
+    else
+    {
+      raise();
+    }
+
+    // add the value to its parent, completing all containers that end here
+    while (true)
+    {
+      if (stack.empty())
+      {
+        return value;
+      }
+
+      ImportFrame& frame = stack.back();
+      if (frame.is_map)
+      {
+        frame.map.push_back(MapEntry(std::move(frame.key), std::move(value)));
+      }
+      else
+      {
+        frame.seq.push_back(std::move(value));
+      }
+
+      c = peek();
+      if (c == ',')
+      {
+        read();
+        skipWs();
+        if (frame.is_map)
+        {
+          frame.key = loadKey();
+        }
+        break; // parse the next child
+      }
+      else if (c != (frame.is_map ? '}' : ']'))
+      {
+        raise();
+      }
+
+      read();
+      skipWs();
+      if (frame.is_map)
+      {
+        value = Node(std::move(frame.map));
+      }
+      else
+      {
+        value = Node(std::move(frame.seq));
+      }
+      registerNode(value, std::move(frame.mark));
+      stack.pop_back();
+    }
   }
-  else
+}
+
+String JsonImport::loadKey()
+{
+  String key = parseString();
+  if (read() != ':')
   {
     raise();
-    return Node();
   }
+  skipWs();
+  return key;
 }
 
 Node JsonImport::loadNull()
 {
   ParseMark mark = currentMark();
+  parseLiteral("null");
 
-  if (read() != 'n' ||
-      read() != 'u' ||
-      read() != 'l' ||
-      read() != 'l')
-  {
-    raise();
-  }
-  skipWs();
   Node node;
   registerNode(node, std::move(mark));
   return node;
@@ -370,15 +909,7 @@ Node JsonImport::loadNull()
 Node JsonImport::loadTrue()
 {
   ParseMark mark = currentMark();
-
-  if (read() != 't' ||
-      read() != 'r' ||
-      read() != 'u' ||
-      read() != 'e')
-  {
-    raise();
-  }
-  skipWs();
+  parseLiteral("true");
 
   Node node(true);
   registerNode(node, std::move(mark));
@@ -388,16 +919,7 @@ Node JsonImport::loadTrue()
 Node JsonImport::loadFalse()
 {
   ParseMark mark = currentMark();
-
-  if (read() != 'f' ||
-      read() != 'a' ||
-      read() != 'l' ||
-      read() != 's' ||
-      read() != 'e')
-  {
-    raise();
-  }
-  skipWs();
+  parseLiteral("false");
 
   Node node(false);
   registerNode(node, std::move(mark));
@@ -408,6 +930,43 @@ Node JsonImport::loadNumber()
 {
   ParseMark mark = currentMark();
 
+  Int int_value;
+  Float float_value;
+  Node node;
+  if (parseNumber(int_value, float_value))
+  {
+    node = Node(float_value);
+  }
+  else
+  {
+    node = Node(int_value);
+  }
+  registerNode(node, std::move(mark));
+  return node;
+}
+
+Node JsonImport::loadString()
+{
+  ParseMark mark = currentMark();
+  Node node = parseString();
+  registerNode(node, std::move(mark));
+  return node;
+}
+
+void JsonImport::parseLiteral(const char* literal)
+{
+  for (const char* pos = literal; *pos != '\0'; ++pos)
+  {
+    if (read() != *pos)
+    {
+      raise();
+    }
+  }
+  skipWs();
+}
+
+bool JsonImport::parseNumber(Int& int_value, Float& float_value)
+{
   bool is_negative = false;
   bool has_fraction = false;
   bool has_exponent = false;
@@ -541,132 +1100,28 @@ Node JsonImport::loadNumber()
   {
     // floating point
     std::size_t idx;
-    double value = std::stod(number_str, &idx);
+    float_value = std::stod(number_str, &idx);
     if (idx != number_str.size())
     {
       raise();
     }
+    return true;
+  }
 
-    Node node(value);
-    registerNode(node, std::move(mark));
-    return node;
+  // integer
+  if (is_negative)
+  {
+    int_value = static_cast<Int>(-1*integer);
   }
   else
   {
-    // integer
-    //
-    if (is_negative)
+    if (integer > static_cast<uint64_t>(std::numeric_limits<Int>::max()))
     {
-      // explicit cast to ensure the correct Node constructor is used
-      Node node(static_cast<Int>(-1*integer));
-      parseinfo_.insert(std::make_pair(node.id(), mark));
-      return node;
+      throw OverflowException();
     }
-
-    Node node(integer);
-    registerNode(node, std::move(mark));
-    return node;
+    int_value = static_cast<Int>(integer);
   }
-}
-
-Node JsonImport::loadString()
-{
-  ParseMark mark = currentMark();
-  Node node = parseString();
-  registerNode(node, std::move(mark));
-  return node;
-}
-
-Node JsonImport::loadSequence()
-{
-  ParseMark mark = currentMark();
-  Sequence seq;
-
-  char c = read();
-  assert(c == '[');
-  skipWs();
-
-  c = peek();
-  if (c != ']')
-  {
-    while (true)
-    {
-      seq.push_back(loadValue());
-      c = peek();
-      if (c == ']')
-      {
-        break;
-      }
-      else if (c == ',')
-      {
-        read();
-        skipWs();
-        continue;
-      }
-      else
-      {
-        raise();
-      }
-    } // content loop
-  } // empty sequence switch
-
-  assert(c == ']');
-  read();
-  skipWs();
-
-  Node node(seq);
-  registerNode(node, std::move(mark));
-  return node;
-}
-
-Node JsonImport::loadMap()
-{
-  ParseMark mark = currentMark();
-
-  Map map;
-
-  char c = read();
-  assert(c == '{');
-  skipWs();
-
-  c = peek();
-  if (c != '}')
-  {
-    while (true)
-    {
-      String key = parseString();
-      c = read();
-      if (c != ':')
-      {
-        raise();
-      }
-      skipWs();
-      map.push_back(MapEntry(key, loadValue()));
-      c = peek();
-      if (c == '}')
-      {
-        break;
-      }
-      else if (c == ',')
-      {
-        read();
-        skipWs();
-        continue;
-      }
-      else
-      {
-        raise();
-      }
-    } // content loop
-  } // empty map switch
-
-  assert(c == '}');
-  read();
-  skipWs();
-
-  Node node(map);
-  registerNode(node, std::move(mark));
-  return node;
+  return false;
 }
 
 String JsonImport::parseString()
@@ -0,0 +1,524 @@
+/*
+ * jsonformatter.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "cpds/node.hpp"
+#include "numformat.hpp"
+#include "writebuffer.hpp"
+
+namespace cpds {
+namespace detail {
+
+/**
+ * Escape character for every byte value.
+ * 0 denotes bytes that are copied as-is, 'u' denotes a \u00XX escape.
+ **/
+extern const char k_json_escapes[256];
+
+/**
+ * Returns the first character within [pos, end) that needs to be escaped,
+ * or end if there is none.
+ **/
+const char* findJsonEscape(const char* pos, const char* end);
+
+/**
+ * Layout without any whitespace.
+ **/
+class CompactStyle
+{
+public:
+  explicit CompactStyle(unsigned) {}
+
+  void open(WriteBuffer&) {}
+  void separate(WriteBuffer&) {}
+  void closeSequence(WriteBuffer&) {}
+  void closeMap(WriteBuffer&) {}
+  void assign(WriteBuffer& buffer) { buffer.put(':'); }
+  void setDepth(unsigned) {}
+}; // class CompactStyle
+
+/**
+ * Layout with one child per line, indented by the nesting level.
+ **/
+class PrettyStyle
+{
+public:
+  explicit PrettyStyle(unsigned indent) : indent_(indent) {}
+
+  void open(WriteBuffer& buffer);
+  void separate(WriteBuffer& buffer) { newline(buffer); }
+  void closeSequence(WriteBuffer& buffer);
+  void closeMap(WriteBuffer& buffer);
+  void assign(WriteBuffer& buffer) { buffer.write(": ", 2); }
+  void setDepth(unsigned depth) { offset_ = depth * indent_; }
+
+private:
+  void newline(WriteBuffer& buffer);
+
+  unsigned indent_;
+  unsigned offset_ = 0;
+}; // class PrettyStyle
+
+/**
+ * Layout chosen at runtime, compact for an indent of 0.
+ * Used where the layout is not known when the formatter type is selected.
+ **/
+class RuntimeStyle
+{
+public:
+  explicit RuntimeStyle(unsigned indent)
+    : compact_(indent)
+    , pretty_(indent)
+    , is_pretty_(indent != 0)
+  {
+  }
+
+  void open(WriteBuffer& buffer);
+  void separate(WriteBuffer& buffer);
+  void closeSequence(WriteBuffer& buffer);
+  void closeMap(WriteBuffer& buffer);
+  void assign(WriteBuffer& buffer);
+  void setDepth(unsigned depth) { pretty_.setDepth(depth); }
+
+private:
+  CompactStyle compact_;
+  PrettyStyle pretty_;
+  bool is_pretty_;
+}; // class RuntimeStyle
+
+/**
+ * Writes JSON text into a WriteBuffer.
+ *
+ * The layout is selected at compile time through the Style policy.
+ * The formatter implements the visitor interface of walk().
+ **/
+template <typename Style>
+class JsonFormatter
+{
+public:
+  /**
+   * A precision of 0 selects the shortest round-trip representation.
+   **/
+  JsonFormatter(WriteBuffer& buffer, unsigned precision, unsigned indent);
+
+  /**
+   * \name Visitor Interface
+   **/
+  //@{
+  void scalar(const Node& node);
+  void beginSequence(const Node&);
+  void element(std::size_t index);
+  void endSequence(const Node&);
+  void beginMap(const Node&);
+  void key(const String& key, std::size_t index);
+  void endMap(const Node&);
+  //@} // Visitor Interface
+
+  /**
+   * \name Building Blocks
+   *
+   * separate() goes before every child, writeKey() before each map value.
+   **/
+  //@{
+  void openSequence();
+  void closeSequence();
+  void openMap();
+  void closeMap();
+  void separate(std::size_t index);
+  void writeKey(const char* key, std::size_t length);
+
+  /**
+   * Continues a document at the given nesting depth, for output that is
+   * produced in fragments. The top-level container has a depth of 1.
+   **/
+  void setDepth(unsigned depth) { style_.setDepth(depth); }
+
+  void writeNull() { buffer_.write("null", 4); }
+  void writeBoolean(bool value);
+  void writeInteger(Int value);
+  void writeFloat(Float value);
+  void writeString(const char* str, std::size_t length);
+  //@} // Building Blocks
+
+private:
+  void writeNumber(Float value);
+
+  WriteBuffer& buffer_;
+  Style style_;
+  unsigned precision_;
+}; // class JsonFormatter
+
+//
+// inline implementations
+//
+
+inline const char* findJsonEscape(const char* pos, const char* end)
+{
+#ifdef __SSE2__
+  // 16 bytes at a time: '"', '\\', '/' and control characters (<= 0x1f)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i slash = _mm_set1_epi8('/');
+  const __m128i control = _mm_set1_epi8(0x1f);
+  while (end - pos >= 16)
+  {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+    __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(block, quote),
+                     _mm_cmpeq_epi8(block, backslash)),
+        _mm_or_si128(_mm_cmpeq_epi8(block, slash),
+                     _mm_cmpeq_epi8(_mm_max_epu8(block, control), control)));
+    int mask = _mm_movemask_epi8(hits);
+    if (mask != 0)
+    {
+      return pos + __builtin_ctz(mask);
+    }
+    pos += 16;
+  }
+#else
+  // 8 bytes at a time, see "Bit Twiddling Hacks" for the zero byte test
+  const uint64_t ones = 0x0101010101010101ull;
+  const uint64_t highs = 0x8080808080808080ull;
+  while (end - pos >= 8)
+  {
+    uint64_t block;
+    std::memcpy(&block, pos, sizeof(block));
+    uint64_t quote = block ^ (ones * '"');
+    uint64_t backslash = block ^ (ones * '\\');
+    uint64_t slash = block ^ (ones * '/');
+    uint64_t hits = ((quote - ones) & ~quote) |
+                    ((backslash - ones) & ~backslash) |
+                    ((slash - ones) & ~slash) |
+                    ((block - ones * 0x20) & ~block);
+    if ((hits & highs) != 0)
+    {
+      break; // the exact position is determined below
+    }
+    pos += 8;
+  }
+#endif
+
+  while (pos != end && k_json_escapes[static_cast<unsigned char>(*pos)] == 0)
+  {
+    ++pos;
+  }
+  return pos;
+}
+
+inline void PrettyStyle::open(WriteBuffer& buffer)
+{
+  offset_ += indent_;
+  newline(buffer);
+}
+
+inline void PrettyStyle::closeSequence(WriteBuffer& buffer)
+{
+  offset_ -= indent_;
+  newline(buffer);
+}
+
+inline void PrettyStyle::closeMap(WriteBuffer& buffer)
+{
+  offset_ -= indent_;
+  newline(buffer);
+
+  // the trailing bracket of the top-level object goes onto a new line
+  if (offset_ == 0)
+  {
+    buffer.put('\n');
+  }
+}
+
+inline void PrettyStyle::newline(WriteBuffer& buffer)
+{
+  if (offset_ == 0)
+  {
+    return;
+  }
+  buffer.put('\n');
+  buffer.fill(' ', offset_);
+}
+
+inline void RuntimeStyle::open(WriteBuffer& buffer)
+{
+  if (is_pretty_)
+  {
+    pretty_.open(buffer);
+  }
+}
+
+inline void RuntimeStyle::separate(WriteBuffer& buffer)
+{
+  if (is_pretty_)
+  {
+    pretty_.separate(buffer);
+  }
+}
+
+inline void RuntimeStyle::closeSequence(WriteBuffer& buffer)
+{
+  if (is_pretty_)
+  {
+    pretty_.closeSequence(buffer);
+  }
+}
+
+inline void RuntimeStyle::closeMap(WriteBuffer& buffer)
+{
+  if (is_pretty_)
+  {
+    pretty_.closeMap(buffer);
+  }
+}
+
+inline void RuntimeStyle::assign(WriteBuffer& buffer)
+{
+  if (is_pretty_)
+  {
+    pretty_.assign(buffer);
+  }
+  else
+  {
+    compact_.assign(buffer);
+  }
+}
+
+template <typename Style>
+JsonFormatter<Style>::JsonFormatter(WriteBuffer& buffer, unsigned precision,
+                                    unsigned indent)
+  : buffer_(buffer)
+  , style_(indent)
+  , precision_(precision)
+{
+}
+
+template <typename Style>
+void JsonFormatter<Style>::scalar(const Node& node)
+{
+  switch (node.type())
+  {
+  case NodeType::Null:
+    writeNull();
+    break;
+  case NodeType::Boolean:
+    writeBoolean(node.boolValue());
+    break;
+  case NodeType::Integer:
+    writeInteger(node.intValue());
+    break;
+  case NodeType::FloatingPoint:
+    writeFloat(node.floatValue());
+    break;
+  case NodeType::String:
+  {
+    const String& str = node.stringValue();
+    writeString(str.data(), str.size());
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::beginSequence(const Node&)
+{
+  openSequence();
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::element(std::size_t index)
+{
+  separate(index);
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::endSequence(const Node&)
+{
+  closeSequence();
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::beginMap(const Node&)
+{
+  openMap();
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::key(const String& key, std::size_t index)
+{
+  separate(index);
+  writeKey(key.data(), key.size());
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::endMap(const Node&)
+{
+  closeMap();
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::openSequence()
+{
+  buffer_.put('[');
+  style_.open(buffer_);
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::closeSequence()
+{
+  style_.closeSequence(buffer_);
+  buffer_.put(']');
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::openMap()
+{
+  buffer_.put('{');
+  style_.open(buffer_);
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::closeMap()
+{
+  style_.closeMap(buffer_);
+  buffer_.put('}');
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::separate(std::size_t index)
+{
+  if (index > 0)
+  {
+    buffer_.put(',');
+    style_.separate(buffer_);
+  }
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::writeKey(const char* key, std::size_t length)
+{
+  writeString(key, length);
+  style_.assign(buffer_);
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::writeBoolean(bool value)
+{
+  if (value)
+  {
+    buffer_.write("true", 4);
+  }
+  else
+  {
+    buffer_.write("false", 5);
+  }
+}
+
+template <typename Style>
+inline void JsonFormatter<Style>::writeInteger(Int value)
+{
+  char* pos = buffer_.reserve(k_max_number_length);
+  buffer_.commit(formatInteger(pos, value) - pos);
+}
+
+template <typename Style>
+void JsonFormatter<Style>::writeFloat(Float value)
+{
+  // need to handle +Inf, -Inf, and NaN.
+  if (std::isfinite(value))
+  {
+    writeNumber(value);
+  }
+  else if (value == std::numeric_limits<double>::infinity())
+  {
+    writeNumber(std::numeric_limits<double>::max());
+  }
+  else if (value == -std::numeric_limits<double>::infinity())
+  {
+    writeNumber(std::numeric_limits<double>::lowest());
+  }
+  else // NaN
+  {
+    writeNull();
+  }
+}
+
+template <typename Style>
+void JsonFormatter<Style>::writeString(const char* str, std::size_t length)
+{
+  static const char k_hex[] = "0123456789abcdef";
+
+  buffer_.put('"');
+
+  // unescaped runs are copied as a whole
+  const char* run = str;
+  const char* end = str + length;
+  while (true)
+  {
+    const char* pos = findJsonEscape(run, end);
+    buffer_.write(run, pos - run);
+    if (pos == end)
+    {
+      break;
+    }
+
+    unsigned char c = static_cast<unsigned char>(*pos);
+    char escape = k_json_escapes[c];
+    if (escape == 'u') // control character
+    {
+      char seq[6] = { '\\', 'u', '0', '0', k_hex[c >> 4], k_hex[c & 0xf] };
+      buffer_.write(seq, sizeof(seq));
+    }
+    else
+    {
+      char seq[2] = { '\\', escape };
+      buffer_.write(seq, sizeof(seq));
+    }
+    run = pos + 1;
+  }
+
+  buffer_.put('"');
+}
+
+template <typename Style>
+void JsonFormatter<Style>::writeNumber(Float value)
+{
+  char* begin = buffer_.reserve(precision_ + k_max_number_length + 2);
+  char* end;
+  if (precision_ == 0)
+  {
+    end = formatShortest(begin, value);
+  }
+  else
+  {
+    end = formatPrecision(begin, value, precision_);
+  }
+
+  // always print a fractional part.
+  // this aids identification of floating point numbers when JSON is parsed.
+  if (isIntegerText(begin, end))
+  {
+    *end++ = '.';
+    *end++ = '0';
+  }
+  buffer_.commit(end - begin);
+}
+
+} // namespace detail
+} // namespace cpds
@@ -12,6 +12,8 @@
 #include <limits>
 #include <algorithm>
 #include "cpds/exception.hpp"
+#include "cpds/reclaimer.hpp"
+#include "parallel.hpp"
 
 namespace cpds {
 
@@ -45,6 +47,14 @@ struct MapCompare
   }
 }; // struct MapCompare
 
+// minimum number of children before a layered merge is run in parallel
+constexpr std::size_t k_parallel_merge_threshold = 64;
+
+inline bool isContainer(NodeType type)
+{
+  return (type == NodeType::Sequence || type == NodeType::Map);
+}
+
 inline void prepareMap(Map& map)
 {
   if (map.empty())
@@ -69,6 +79,21 @@ inline void prepareMap(Map& map)
 
 } // unnamed namespace
 
+template <typename Container>
+struct Node::Tracked : Container
+{
+  template <typename... Args>
+  explicit Tracked(Args&&... args)
+    : Container(std::forward<Args>(args)...)
+    , revision(s_revision_.fetch_add(1, std::memory_order_relaxed) + 1)
+    , refs(1)
+  {
+  }
+
+  uint64_t revision;
+  std::atomic<uint32_t> refs; // number of nodes that share the container
+}; // struct Node::Tracked
+
 Node::Node(const Node& other)
   : type_(other.type_)
   , id_(other.id_)
@@ -81,10 +106,22 @@ Node::Node(const Node& other)
     storage_.str_ = new String(other._string());
     break;
   case NodeType::Sequence:
-    storage_.seq_ = new Sequence(other._sequence());
-    break;
   case NodeType::Map:
-    storage_.map_ = new Map(other._map());
+    if (other.isShared())
+    {
+      refCount().fetch_add(1, std::memory_order_relaxed);
+      break;
+    }
+    type_ = NodeType::Null; // nothing allocated yet
+    try
+    {
+      copyTree(other);
+    }
+    catch (...)
+    {
+      clear();
+      throw;
+    }
     break;
   default:
     break;
@@ -133,7 +170,7 @@ Node::Node(const Sequence& value)
   , id_(_nextId())
   , storage_()
 {
-  storage_.seq_ = new Sequence(value);
+  storage_.seq_ = new Tracked<Sequence>(value);
 }
 
 Node::Node(Sequence&& value)
@@ -141,7 +178,7 @@ Node::Node(Sequence&& value)
   , id_(_nextId())
   , storage_()
 {
-  storage_.seq_ = new Sequence(std::move(value));
+  storage_.seq_ = new Tracked<Sequence>(std::move(value));
 }
 
 Node::Node(const Map& value)
@@ -149,7 +186,7 @@ Node::Node(const Map& value)
   , id_(_nextId())
   , storage_()
 {
-  storage_.map_ = new Map(value);
+  storage_.map_ = new Tracked<Map>(value);
 
   prepareMap(*storage_.map_);
 }
@@ -159,27 +196,14 @@ Node::Node(Map&& value)
   , id_(_nextId())
   , storage_()
 {
-  storage_.map_ = new Map(std::move(value));
+  storage_.map_ = new Tracked<Map>(std::move(value));
 
   prepareMap(*storage_.map_);
 }
 
 Node::~Node() noexcept
 {
-  switch (type_)
-  {
-  case NodeType::String:
-    delete storage_.str_;
-    break;
-  case NodeType::Sequence:
-    delete storage_.seq_;
-    break;
-  case NodeType::Map:
-    delete storage_.map_;
-    break;
-  default:
-    break;
-  }
+  clear();
 }
 
 std::size_t Node::size() const noexcept
@@ -269,6 +293,8 @@ Sequence& Node::sequence()
   {
     throw TypeException(*this);
   }
+  detach();
+  touch();
   return _sequence();
 }
 
@@ -333,7 +359,14 @@ const Node& Node::at(const String& key) const
 
 Map::iterator Node::find(const String& key)
 {
-  Map& m = map();
+  // the iterator allows modification, shared data is detached first
+  if (type_ != NodeType::Map)
+  {
+    throw TypeException(*this);
+  }
+  detach();
+  touch();
+  Map& m = _map();
 
   MapCompare comp;
   auto iter = std::lower_bound(m.begin(), m.end(), key, comp);
@@ -359,7 +392,13 @@ Map::const_iterator Node::find(const String& key) const
 
 Map::iterator Node::end()
 {
-  return map().end();
+  if (type_ != NodeType::Map)
+  {
+    throw TypeException(*this);
+  }
+  detach();
+  touch();
+  return _map().end();
 }
 
 Map::const_iterator Node::end() const
@@ -381,25 +420,100 @@ std::size_t Node::erase(const String& key)
 
 void Node::merge(const Node& other)
 {
-  if (type_ == NodeType::Sequence && other.type_ == NodeType::Sequence)
+  if (&other == this)
+  {
+    return; // merging a node into itself does not change it
+  }
+
+  // nested containers are merged from an explicit stack
+  PendingMerges pending;
+  Node* dst = this;
+  const Node* src = &other;
+  while (true)
+  {
+    dst->mergeShallow(*src, pending);
+    if (pending.empty())
+    {
+      break;
+    }
+    dst = pending.back().first;
+    src = pending.back().second;
+    pending.pop_back();
+  }
+}
+
+void Node::merge(const std::vector<const Node*>& others, unsigned num_threads)
+{
+  if (others.empty())
   {
-    mergeSequence(other);
     return;
   }
-  else if (type_ == NodeType::Map && other.type_ == NodeType::Map)
+
+  // the layers must not observe the partially merged result
+  if (std::find(others.begin(), others.end(), this) != others.end())
   {
-    mergeMap(other);
+    Node copy(*this);
+    std::vector<const Node*> layers(others);
+    std::replace(layers.begin(), layers.end(),
+                 static_cast<const Node*>(this),
+                 static_cast<const Node*>(&copy));
+    mergeLayers(layers.data(), layers.size(), num_threads);
     return;
   }
 
-  // abort if any sequence / map is involved
-  if (type_ == NodeType::Sequence || other.type_ == NodeType::Sequence ||
-      type_ == NodeType::Map || other.type_ == NodeType::Map)
+  mergeLayers(others.data(), others.size(), num_threads);
+}
+
+uint64_t Node::revision() const noexcept
+{
+  switch (type_)
   {
-    throw TypeException(other);
+  case NodeType::Sequence:
+    return static_cast<const Tracked<Sequence>*>(storage_.seq_)->revision;
+  case NodeType::Map:
+    return static_cast<const Tracked<Map>*>(storage_.map_)->revision;
+  default:
+    return 0;
   }
+}
 
-  *this = other; // default copy assignments
+void Node::touch() noexcept
+{
+  uint64_t revision = s_revision_.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (type_ == NodeType::Sequence)
+  {
+    static_cast<Tracked<Sequence>*>(storage_.seq_)->revision = revision;
+  }
+  else if (type_ == NodeType::Map)
+  {
+    static_cast<Tracked<Map>*>(storage_.map_)->revision = revision;
+  }
+}
+
+Node Node::share() const
+{
+  if (!isContainer(type_))
+  {
+    return *this;
+  }
+
+  Node node{Shell()};
+  refCount().fetch_add(1, std::memory_order_relaxed);
+  node.type_ = type_;
+  node.id_ = id_;
+  node.storage_ = storage_;
+  return node;
+}
+
+bool Node::isShared() const noexcept
+{
+  return (isContainer(type_) &&
+          refCount().load(std::memory_order_acquire) > 1);
+}
+
+void Node::releaseAsync()
+{
+  Reclaimer::global().retire(std::move(*this));
 }
 
 void Node::swap(Node& other) noexcept
@@ -426,10 +540,13 @@ Map& Node::map()
   {
     throw TypeException(*this);
   }
+  detach();
+  touch();
   return _map();
 }
 
 std::atomic<uint32_t> Node::s_id_(0);
+std::atomic<uint64_t> Node::s_revision_(0);
 
 inline bool Node::_bool() const
 {
@@ -476,6 +593,67 @@ inline Map& Node::_map()
   return *(storage_.map_);
 }
 
+std::atomic<uint32_t>& Node::refCount() const noexcept
+{
+  if (type_ == NodeType::Sequence)
+  {
+    return static_cast<Tracked<Sequence>*>(storage_.seq_)->refs;
+  }
+  return static_cast<Tracked<Map>*>(storage_.map_)->refs;
+}
+
+void Node::detach()
+{
+  if (!isShared())
+  {
+    return;
+  }
+
+  // the children of shared data are immutable as well, hence they are
+  // shared instead of copied
+  Node copy{Shell()};
+  copy.id_ = id_;
+  if (type_ == NodeType::Sequence)
+  {
+    copy.storage_.seq_ = new Tracked<Sequence>();
+    copy.type_ = NodeType::Sequence;
+    Sequence& seq = copy._sequence();
+    seq.reserve(_sequence().size());
+    for (const Node& child : _sequence())
+    {
+      seq.push_back(child.share());
+    }
+  }
+  else
+  {
+    copy.storage_.map_ = new Tracked<Map>();
+    copy.type_ = NodeType::Map;
+    Map& map = copy._map();
+    map.reserve(_map().size());
+    for (const MapEntry& entry : _map())
+    {
+      map.emplace_back(entry.first, entry.second.share());
+    }
+  }
+  swap(copy); // the copy releases the shared data
+}
+
+bool Node::release() noexcept
+{
+  std::atomic<uint32_t>& refs = refCount();
+  if (refs.load(std::memory_order_acquire) == 1)
+  {
+    return true;
+  }
+  if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+  {
+    // the other nodes released the data in the meantime
+    refs.store(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
 void Node::checkValue(unsigned long long int value)
 {
   if (value > std::numeric_limits<long long int>::max())
@@ -484,50 +662,612 @@ void Node::checkValue(unsigned long long int value)
   }
 }
 
-void Node::mergeSequence(const Node& other)
+void Node::clear() noexcept
+{
+  switch (type_)
+  {
+  case NodeType::String:
+    delete storage_.str_;
+    break;
+  case NodeType::Sequence:
+  case NodeType::Map:
+    if (!release())
+    {
+      break; // still in use by other nodes
+    }
+    if (hasNestedContainers())
+    {
+      releaseTree();
+    }
+    if (type_ == NodeType::Sequence)
+    {
+      delete static_cast<Tracked<Sequence>*>(storage_.seq_);
+    }
+    else if (type_ == NodeType::Map)
+    {
+      delete static_cast<Tracked<Map>*>(storage_.map_);
+    }
+    break;
+  default:
+    break;
+  }
+  type_ = NodeType::Null;
+}
+
+bool Node::hasNestedContainers() const noexcept
+{
+  // shared children are only released, see releaseTree()
+  if (type_ == NodeType::Sequence)
+  {
+    for (const Node& child : _sequence())
+    {
+      if (isContainer(child.type_) && child.size() > 0 && !child.isShared())
+      {
+        return true;
+      }
+    }
+  }
+  else if (type_ == NodeType::Map)
+  {
+    for (const MapEntry& entry : _map())
+    {
+      if (isContainer(entry.second.type_) && entry.second.size() > 0 &&
+          !entry.second.isShared())
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void Node::releaseTree() noexcept
+{
+  // the non-empty child containers are detached and destroyed from an
+  // explicit stack, such that every destructor only frees flat containers;
+  // shared children stay in place and merely drop their reference
+  std::vector<Node> pending;
+  try
+  {
+    pending.push_back(std::move(*this));
+    while (!pending.empty())
+    {
+      Node node(std::move(pending.back()));
+      pending.pop_back();
+      if (node.type_ == NodeType::Sequence)
+      {
+        for (Node& child : node._sequence())
+        {
+          if (isContainer(child.type_) && child.size() > 0 &&
+              !child.isShared())
+          {
+            pending.push_back(std::move(child));
+          }
+        }
+      }
+      else
+      {
+        for (MapEntry& entry : node._map())
+        {
+          if (isContainer(entry.second.type_) && entry.second.size() > 0 &&
+              !entry.second.isShared())
+          {
+            pending.push_back(std::move(entry.second));
+          }
+        }
+      }
+    }
+  }
+  catch (...)
+  {
+    // out of memory, the remaining nodes are destroyed recursively
+  }
+}
+
+void Node::copyTree(const Node& other)
+{
+  // nested containers are copied from an explicit stack, such that the
+  // stack usage does not depend on the nesting depth
+  PendingCopies pending;
+  Node* dst = this;
+  const Node* src = &other;
+  while (true)
+  {
+    dst->copyShallow(*src, pending);
+    if (pending.empty())
+    {
+      break;
+    }
+    dst = pending.back().first;
+    src = pending.back().second;
+    pending.pop_back();
+  }
+}
+
+void Node::copyShallow(const Node& other, PendingCopies& pending)
+{
+  // this node is null, child containers are copied later on
+  id_ = other.id_;
+  if (other.type_ == NodeType::Sequence)
+  {
+    const Sequence& other_seq = other._sequence();
+    storage_.seq_ = new Tracked<Sequence>();
+    type_ = NodeType::Sequence;
+
+    Sequence& seq = _sequence();
+    seq.reserve(other_seq.size());
+    for (const Node& child : other_seq)
+    {
+      if (isContainer(child.type_) && !child.isShared())
+      {
+        seq.push_back(Node(Shell()));
+        pending.emplace_back(&seq.back(), &child);
+      }
+      else
+      {
+        seq.push_back(child);
+      }
+    }
+  }
+  else
+  {
+    const Map& other_map = other._map();
+    storage_.map_ = new Tracked<Map>();
+    type_ = NodeType::Map;
+
+    Map& map = _map();
+    map.reserve(other_map.size());
+    for (const MapEntry& entry : other_map)
+    {
+      if (isContainer(entry.second.type_) && !entry.second.isShared())
+      {
+        map.emplace_back(entry.first, Node(Shell()));
+        pending.emplace_back(&map.back().second, &entry.second);
+      }
+      else
+      {
+        map.push_back(entry);
+      }
+    }
+  }
+}
+
+void Node::mergeShallow(const Node& other, PendingMerges& pending)
+{
+  if (type_ == NodeType::Sequence && other.type_ == NodeType::Sequence)
+  {
+    mergeSequence(other, pending);
+    return;
+  }
+  else if (type_ == NodeType::Map && other.type_ == NodeType::Map)
+  {
+    mergeMap(other, pending);
+    return;
+  }
+
+  // abort if any sequence / map is involved
+  if (isContainer(type_) || isContainer(other.type_))
+  {
+    throw TypeException(other);
+  }
+
+  *this = other; // default copy assignments
+}
+
+void Node::mergeSequence(const Node& other, PendingMerges& pending)
 {
+  detach();
+  touch();
   Sequence& loc_seq = _sequence();
   const Sequence& other_seq = other._sequence();
   std::size_t num_merges = std::min(loc_seq.size(), other_seq.size());
 
-  for (std::size_t i = 0; i < num_merges; ++i)
+  // append first, as the insertion invalidates pointers to the children
+  loc_seq.insert(loc_seq.end(), other_seq.begin()+num_merges, other_seq.end());
+
+  // process in reverse, such that the children are merged in order
+  for (std::size_t i = num_merges; i-- > 0;)
   {
-    loc_seq[i].merge(other_seq[i]);
+    pending.emplace_back(&loc_seq[i], &other_seq[i]);
   }
-  loc_seq.insert(loc_seq.end(), other_seq.begin()+num_merges, other_seq.end());
 }
 
-void Node::mergeMap(const Node& other)
+void Node::mergeMap(const Node& other, PendingMerges& pending)
 {
+  detach();
+  touch();
   Map& loc_map = _map();
   const Map& other_map = other._map();
-  Map::iterator loc_iter = loc_map.begin();
   MapCompare comp;
-  for (Map::const_iterator other_iter = other_map.begin();
-       other_iter != other_map.end(); ++other_iter)
+
+  // count the keys of the result
+  std::size_t num_keys = loc_map.size();
+  Map::const_iterator loc_iter = loc_map.begin();
+  for (const MapEntry& entry : other_map)
   {
-    // progress the local iter until or past the other key
-    while (loc_iter != loc_map.end() && comp(*loc_iter, *other_iter) == true)
+    while (loc_iter != loc_map.end() && comp(*loc_iter, entry))
     {
       ++loc_iter;
     }
-    // if the key matches, merge recursively else insert at the current position
-    if (loc_iter != loc_map.end() && comp(*other_iter, *loc_iter) == false)
+    if (loc_iter == loc_map.end() || comp(entry, *loc_iter))
     {
-      (*loc_iter).second.merge((*other_iter).second);
-      ++loc_iter;
+      num_keys++;
+    }
+  }
+
+  std::size_t first_pending = pending.size();
+  if (num_keys == loc_map.size())
+  {
+    // all keys exist already, merge in place
+    Map::iterator iter = loc_map.begin();
+    for (const MapEntry& entry : other_map)
+    {
+      while (comp(*iter, entry))
+      {
+        ++iter;
+      }
+      pending.emplace_back(&iter->second, &entry.second);
+    }
+  }
+  else
+  {
+    // build the result in a single pass; the reserved storage keeps the
+    // pointers to the children valid
+    Map result;
+    result.reserve(num_keys);
+    Map::iterator iter = loc_map.begin();
+    for (const MapEntry& entry : other_map)
+    {
+      while (iter != loc_map.end() && comp(*iter, entry))
+      {
+        result.push_back(std::move(*iter));
+        ++iter;
+      }
+      if (iter != loc_map.end() && !comp(entry, *iter))
+      {
+        result.push_back(std::move(*iter));
+        ++iter;
+        pending.emplace_back(&result.back().second, &entry.second);
+      }
+      else
+      {
+        result.push_back(entry);
+      }
+    }
+    result.insert(result.end(), std::make_move_iterator(iter),
+                  std::make_move_iterator(loc_map.end()));
+    loc_map.swap(result);
+  }
+
+  // process in reverse, such that the children are merged in order
+  std::reverse(pending.begin() + first_pending, pending.end());
+}
+
+void Node::mergeLayers(const Node* const* layers, std::size_t count,
+                       unsigned num_threads)
+{
+  std::vector<const Node*> sources(layers, layers + count);
+  std::vector<MergeJob> jobs;
+  mergeStep(*this, sources, 0, count, jobs);
+
+  if (jobs.size() >= k_parallel_merge_threshold &&
+      detail::resolveThreads(num_threads) > 1)
+  {
+    // every worker processes its share of the children independently
+    detail::parallelFor(jobs.size(), num_threads,
+                        [&](std::size_t begin, std::size_t end)
+    {
+      std::vector<const Node*> local_sources;
+      std::vector<MergeJob> local_jobs;
+      for (std::size_t j = begin; j < end; ++j)
+      {
+        MergeJob job = jobs[j];
+        local_sources.assign(sources.begin() + job.first,
+                             sources.begin() + job.first + job.count);
+        job.first = 0;
+        local_jobs.assign(1, job);
+        runMergeJobs(local_sources, local_jobs);
+      }
+    });
+  }
+  else
+  {
+    runMergeJobs(sources, jobs);
+  }
+}
+
+void Node::runMergeJobs(std::vector<const Node*>& sources,
+                        std::vector<MergeJob>& jobs)
+{
+  while (!jobs.empty())
+  {
+    MergeJob job = jobs.back();
+    jobs.pop_back();
+
+    // the sources above the current job belong to completed jobs
+    sources.resize(job.first + job.count);
+
+    Node& target = *job.target;
+    if (job.has_base)
+    {
+      mergeStep(target, sources, job.first, job.count, jobs);
+    }
+    else if (job.count == 1)
+    {
+      target = *sources[job.first];
     }
     else
     {
-      // the insert operation will invalidate the local iterator
-      unsigned distance = std::distance(loc_map.begin(), loc_iter);
-      loc_map.insert(loc_iter, *other_iter);
-      loc_iter = loc_map.begin()+distance;
+      // start from an empty container (or the scalar) of the lowest layer
+      const Node& base = *sources[job.first];
+      if (isContainer(base.type_))
+      {
+        if (base.type_ == NodeType::Sequence)
+        {
+          target = Sequence();
+        }
+        else
+        {
+          target = Map();
+        }
+        target.id_ = base.id_;
+        mergeStep(target, sources, job.first, job.count, jobs);
+      }
+      else
+      {
+        target = base;
+        mergeStep(target, sources, job.first+1, job.count-1, jobs);
+      }
     }
   }
 }
 
+void Node::mergeStep(Node& target, std::vector<const Node*>& sources,
+                     std::size_t first, std::size_t count,
+                     std::vector<MergeJob>& jobs)
+{
+  // note: the sources vector grows during the step, hence all layers are
+  // accessed by index
+
+  // the same rules as for pairwise merges apply between consecutive layers
+  const Node* prev = &target;
+  for (std::size_t i = first; i < first + count; ++i)
+  {
+    const Node* cur = sources[i];
+    if (prev->type_ != cur->type_ &&
+        (isContainer(prev->type_) || isContainer(cur->type_)))
+    {
+      throw TypeException(*cur);
+    }
+    prev = cur;
+  }
+
+  if (count == 0)
+  {
+    return;
+  }
+  else if (target.type_ == NodeType::Sequence)
+  {
+    target.detach();
+    target.touch();
+    Sequence& loc_seq = target._sequence();
+    std::size_t num_local = loc_seq.size();
+    std::size_t num_total = num_local;
+    for (std::size_t i = first; i < first + count; ++i)
+    {
+      num_total = std::max(num_total, sources[i]->_sequence().size());
+    }
+    loc_seq.resize(num_total);
+
+    // collect the contributing layers for every index
+    for (std::size_t index = 0; index < num_total; ++index)
+    {
+      MergeJob job{&loc_seq[index], index < num_local, sources.size(), 0, index};
+      for (std::size_t i = first; i < first + count; ++i)
+      {
+        const Sequence& seq = sources[i]->_sequence();
+        if (index < seq.size())
+        {
+          sources.push_back(&seq[index]);
+          job.count++;
+        }
+      }
+      if (job.count > 0)
+      {
+        jobs.push_back(job);
+      }
+    }
+  }
+  else if (target.type_ == NodeType::Map)
+  {
+    target.detach();
+    target.touch();
+    Map& loc_map = target._map();
+    std::vector<Map::const_iterator> iters(count);
+    std::size_t max_size = loc_map.size();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      const Map& map = sources[first+i]->_map();
+      iters[i] = map.begin();
+      max_size = std::max(max_size, map.size());
+    }
+
+    // k-way merge of the sorted keys, each output key is produced once;
+    // the children are referenced by index until the result is complete
+    Map result;
+    result.reserve(max_size);
+    std::size_t first_job = jobs.size();
+    Map::iterator loc_iter = loc_map.begin();
+    while (true)
+    {
+      const String* key = nullptr;
+      if (loc_iter != loc_map.end())
+      {
+        key = &loc_iter->first;
+      }
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        if (iters[i] != sources[first+i]->_map().end() &&
+            (key == nullptr || iters[i]->first < *key))
+        {
+          key = &iters[i]->first;
+        }
+      }
+      if (key == nullptr)
+      {
+        break; // all maps are exhausted
+      }
+
+      MergeJob job{nullptr, false, sources.size(), 0, result.size()};
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        if (iters[i] != sources[first+i]->_map().end() &&
+            iters[i]->first == *key)
+        {
+          sources.push_back(&iters[i]->second);
+          job.count++;
+        }
+      }
+
+      if (loc_iter != loc_map.end() && loc_iter->first == *key)
+      {
+        job.has_base = true;
+        result.push_back(std::move(*loc_iter));
+        ++loc_iter;
+      }
+      else
+      {
+        result.emplace_back(*key, Node(Shell()));
+      }
+
+      // advance all layers that contributed to the key
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        if (iters[i] != sources[first+i]->_map().end() &&
+            iters[i]->first == result.back().first)
+        {
+          ++iters[i];
+        }
+      }
+
+      if (job.count > 0)
+      {
+        jobs.push_back(job);
+      }
+    }
+
+    loc_map.swap(result);
+    for (std::size_t j = first_job; j < jobs.size(); ++j)
+    {
+      jobs[j].target = &loc_map[jobs[j].index].second;
+    }
+  }
+  else
+  {
+    target = *sources[first+count-1]; // the topmost scalar wins
+  }
+}
+
 bool operator==(const Node& lhs, const Node& rhs) noexcept
+{
+  // nested containers are compared from an explicit stack
+  try
+  {
+    Node::PendingComparisons pending;
+    const Node* a = &lhs;
+    const Node* b = &rhs;
+    while (true)
+    {
+      if (!Node::equalShallow(*a, *b, pending))
+      {
+        return false;
+      }
+      if (pending.empty())
+      {
+        return true;
+      }
+      a = pending.back().first;
+      b = pending.back().second;
+      pending.pop_back();
+    }
+  }
+  catch (...)
+  {
+    // out of memory, fall back to the recursive comparison
+    return Node::equalRecursive(lhs, rhs);
+  }
+}
+
+bool Node::equalShallow(const Node& lhs, const Node& rhs,
+                        PendingComparisons& pending)
+{
+  if (lhs.type_ != rhs.type_)
+  {
+    return false;
+  }
+
+  switch (lhs.type_)
+  {
+  case NodeType::Sequence:
+  {
+    const Sequence& lhs_seq = lhs._sequence();
+    const Sequence& rhs_seq = rhs._sequence();
+    if (&lhs_seq == &rhs_seq)
+    {
+      return true; // shared data
+    }
+    if (lhs_seq.size() != rhs_seq.size())
+    {
+      return false;
+    }
+    for (std::size_t i = 0; i < lhs_seq.size(); ++i)
+    {
+      if (!equalChild(lhs_seq[i], rhs_seq[i], pending))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  case NodeType::Map:
+  {
+    const Map& lhs_map = lhs._map();
+    const Map& rhs_map = rhs._map();
+    if (&lhs_map == &rhs_map)
+    {
+      return true; // shared data
+    }
+    if (lhs_map.size() != rhs_map.size())
+    {
+      return false;
+    }
+    for (std::size_t i = 0; i < lhs_map.size(); ++i)
+    {
+      if (lhs_map[i].first != rhs_map[i].first ||
+          !equalChild(lhs_map[i].second, rhs_map[i].second, pending))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  default:
+    return equalRecursive(lhs, rhs); // scalars do not recurse
+  }
+}
+
+inline bool Node::equalChild(const Node& lhs, const Node& rhs,
+                             PendingComparisons& pending)
+{
+  if (isContainer(lhs.type_) && lhs.type_ == rhs.type_)
+  {
+    pending.emplace_back(&lhs, &rhs);
+    return true;
+  }
+  return equalShallow(lhs, rhs, pending);
+}
+
+bool Node::equalRecursive(const Node& lhs, const Node& rhs) noexcept
 {
   if (lhs.type_ == rhs.type_)
   {
@@ -0,0 +1,493 @@
+/*
+ * numformat.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "numformat.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+
+namespace cpds {
+namespace detail {
+
+// enforce local linkage
+namespace {
+
+const char k_digit_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+// writes the digits of value right-aligned, ending before end
+inline char* writeDigitsBackwards(char* end, uint64_t value)
+{
+  while (value >= 100)
+  {
+    unsigned pair = static_cast<unsigned>(value % 100) * 2;
+    value /= 100;
+    *--end = k_digit_pairs[pair + 1];
+    *--end = k_digit_pairs[pair];
+  }
+  if (value >= 10)
+  {
+    unsigned pair = static_cast<unsigned>(value) * 2;
+    *--end = k_digit_pairs[pair + 1];
+    *--end = k_digit_pairs[pair];
+  }
+  else
+  {
+    *--end = static_cast<char>('0' + value);
+  }
+  return end;
+}
+
+//
+// Grisu2, see Florian Loitsch: "Printing Floating-Point Numbers Quickly and
+// Accurately with Integers", PLDI 2010
+//
+
+// floating point number f * 2^e with a 64 bit significand
+struct DiyFp
+{
+  uint64_t f;
+  int e;
+}; // struct DiyFp
+
+inline DiyFp subtract(const DiyFp& x, const DiyFp& y)
+{
+  assert(x.e == y.e && x.f >= y.f);
+  return DiyFp{ x.f - y.f, x.e };
+}
+
+// upper 64 bits of the 128 bit product, rounded
+inline DiyFp multiply(const DiyFp& x, const DiyFp& y)
+{
+  uint64_t x_lo = x.f & 0xffffffffu;
+  uint64_t x_hi = x.f >> 32;
+  uint64_t y_lo = y.f & 0xffffffffu;
+  uint64_t y_hi = y.f >> 32;
+
+  uint64_t p0 = x_lo * y_lo;
+  uint64_t p1 = x_lo * y_hi;
+  uint64_t p2 = x_hi * y_lo;
+  uint64_t p3 = x_hi * y_hi;
+
+  uint64_t q = (p0 >> 32) + (p1 & 0xffffffffu) + (p2 & 0xffffffffu);
+  q += uint64_t(1) << 31; // round half up
+  uint64_t h = p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32);
+  return DiyFp{ h, x.e + y.e + 64 };
+}
+
+inline DiyFp normalize(DiyFp x)
+{
+  while ((x.f >> 63) == 0)
+  {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+inline DiyFp normalizeTo(const DiyFp& x, int e)
+{
+  return DiyFp{ x.f << (x.e - e), e };
+}
+
+// the value and the boundaries of its rounding interval, all with the same
+// exponent
+struct Boundaries
+{
+  DiyFp w;
+  DiyFp minus;
+  DiyFp plus;
+}; // struct Boundaries
+
+Boundaries computeBoundaries(double value)
+{
+  constexpr int k_bias = 1075; // exponent bias + significand bits
+  constexpr uint64_t k_hidden_bit = uint64_t(1) << 52;
+
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint64_t biased_e = (bits >> 52) & 0x7ff;
+  uint64_t fraction = bits & (k_hidden_bit - 1);
+
+  DiyFp v = (biased_e == 0)
+      ? DiyFp{ fraction, 1 - k_bias } // denormal
+      : DiyFp{ fraction + k_hidden_bit, static_cast<int>(biased_e) - k_bias };
+
+  // the lower boundary is closer if the significand is a power of two
+  bool lower_closer = (fraction == 0 && biased_e > 1);
+  DiyFp m_plus{ 2*v.f + 1, v.e - 1 };
+  DiyFp m_minus = lower_closer ? DiyFp{ 4*v.f - 1, v.e - 2 }
+                               : DiyFp{ 2*v.f - 1, v.e - 1 };
+
+  DiyFp w_plus = normalize(m_plus);
+  return Boundaries{ normalize(v), normalizeTo(m_minus, w_plus.e), w_plus };
+}
+
+// target range of the binary exponent of the scaled value
+constexpr int k_alpha = -60;
+constexpr int k_gamma = -32;
+
+// normalized 10^k
+struct CachedPower
+{
+  uint64_t f;
+  int e;
+  int k;
+}; // struct CachedPower
+
+constexpr int k_cached_powers_min_k = -300;
+constexpr int k_cached_powers_step = 8;
+
+const CachedPower k_cached_powers[] = {
+  { 0xAB70FE17C79AC6CA, -1060, -300 },
+  { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+  { 0xBE5691EF416BD60C, -1007, -284 },
+  { 0x8DD01FAD907FFC3C,  -980, -276 },
+  { 0xD3515C2831559A83,  -954, -268 },
+  { 0x9D71AC8FADA6C9B5,  -927, -260 },
+  { 0xEA9C227723EE8BCB,  -901, -252 },
+  { 0xAECC49914078536D,  -874, -244 },
+  { 0x823C12795DB6CE57,  -847, -236 },
+  { 0xC21094364DFB5637,  -821, -228 },
+  { 0x9096EA6F3848984F,  -794, -220 },
+  { 0xD77485CB25823AC7,  -768, -212 },
+  { 0xA086CFCD97BF97F4,  -741, -204 },
+  { 0xEF340A98172AACE5,  -715, -196 },
+  { 0xB23867FB2A35B28E,  -688, -188 },
+  { 0x84C8D4DFD2C63F3B,  -661, -180 },
+  { 0xC5DD44271AD3CDBA,  -635, -172 },
+  { 0x936B9FCEBB25C996,  -608, -164 },
+  { 0xDBAC6C247D62A584,  -582, -156 },
+  { 0xA3AB66580D5FDAF6,  -555, -148 },
+  { 0xF3E2F893DEC3F126,  -529, -140 },
+  { 0xB5B5ADA8AAFF80B8,  -502, -132 },
+  { 0x87625F056C7C4A8B,  -475, -124 },
+  { 0xC9BCFF6034C13053,  -449, -116 },
+  { 0x964E858C91BA2655,  -422, -108 },
+  { 0xDFF9772470297EBD,  -396, -100 },
+  { 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+  { 0xF8A95FCF88747D94,  -343,  -84 },
+  { 0xB94470938FA89BCF,  -316,  -76 },
+  { 0x8A08F0F8BF0F156B,  -289,  -68 },
+  { 0xCDB02555653131B6,  -263,  -60 },
+  { 0x993FE2C6D07B7FAC,  -236,  -52 },
+  { 0xE45C10C42A2B3B06,  -210,  -44 },
+  { 0xAA242499697392D3,  -183,  -36 },
+  { 0xFD87B5F28300CA0E,  -157,  -28 },
+  { 0xBCE5086492111AEB,  -130,  -20 },
+  { 0x8CBCCC096F5088CC,  -103,  -12 },
+  { 0xD1B71758E219652C,   -77,   -4 },
+  { 0x9C40000000000000,   -50,    4 },
+  { 0xE8D4A51000000000,   -24,   12 },
+  { 0xAD78EBC5AC620000,     3,   20 },
+  { 0x813F3978F8940984,    30,   28 },
+  { 0xC097CE7BC90715B3,    56,   36 },
+  { 0x8F7E32CE7BEA5C70,    83,   44 },
+  { 0xD5D238A4ABE98068,   109,   52 },
+  { 0x9F4F2726179A2245,   136,   60 },
+  { 0xED63A231D4C4FB27,   162,   68 },
+  { 0xB0DE65388CC8ADA8,   189,   76 },
+  { 0x83C7088E1AAB65DB,   216,   84 },
+  { 0xC45D1DF942711D9A,   242,   92 },
+  { 0x924D692CA61BE758,   269,  100 },
+  { 0xDA01EE641A708DEA,   295,  108 },
+  { 0xA26DA3999AEF774A,   322,  116 },
+  { 0xF209787BB47D6B85,   348,  124 },
+  { 0xB454E4A179DD1877,   375,  132 },
+  { 0x865B86925B9BC5C2,   402,  140 },
+  { 0xC83553C5C8965D3D,   428,  148 },
+  { 0x952AB45CFA97A0B3,   455,  156 },
+  { 0xDE469FBD99A05FE3,   481,  164 },
+  { 0xA59BC234DB398C25,   508,  172 },
+  { 0xF6C69A72A3989F5C,   534,  180 },
+  { 0xB7DCBF5354E9BECE,   561,  188 },
+  { 0x88FCF317F22241E2,   588,  196 },
+  { 0xCC20CE9BD35C78A5,   614,  204 },
+  { 0x98165AF37B2153DF,   641,  212 },
+  { 0xE2A0B5DC971F303A,   667,  220 },
+  { 0xA8D9D1535CE3B396,   694,  228 },
+  { 0xFB9B7CD9A4A7443C,   720,  236 },
+  { 0xBB764C4CA7A44410,   747,  244 },
+  { 0x8BAB8EEFB6409C1A,   774,  252 },
+  { 0xD01FEF10A657842C,   800,  260 },
+  { 0x9B10A4E5E9913129,   827,  268 },
+  { 0xE7109BFBA19C0C9D,   853,  276 },
+  { 0xAC2820D9623BF429,   880,  284 },
+  { 0x80444B5E7AA7CF85,   907,  292 },
+  { 0xBF21E44003ACDD2D,   933,  300 },
+  { 0x8E679C2F5E44FF8F,   960,  308 },
+  { 0xD433179D9C8CB841,   986,  316 },
+  { 0x9E19DB92B4E31BA9,  1013,  324 },
+  { 0xEB96BF6EBADF77D9,  1039,  332 },
+  { 0xAF87023B9BF0EE6B,  1066,  340 },
+};
+
+// returns 10^-k such that the exponent of the scaled value lies within
+// [k_alpha, k_gamma]
+CachedPower cachedPower(int e)
+{
+  // k = ceil((k_alpha - e - 1) * log10(2))
+  int f = k_alpha - e - 1;
+  int k = (f * 78913) / (1 << 18) + (f > 0);
+  int index = (-k_cached_powers_min_k + k + (k_cached_powers_step - 1)) /
+      k_cached_powers_step;
+  assert(index >= 0 && static_cast<std::size_t>(index) <
+         sizeof(k_cached_powers) / sizeof(k_cached_powers[0]));
+
+  const CachedPower& cached = k_cached_powers[index];
+  assert(k_alpha <= cached.e + e + 64 && cached.e + e + 64 <= k_gamma);
+  (void)k_gamma;
+  return cached;
+}
+
+// largest power of ten <= n, returns the number of digits of n
+inline int largestPow10(uint32_t n, uint32_t& pow10)
+{
+  uint32_t p = 1000000000;
+  int digits = 10;
+  while (p > n && digits > 1)
+  {
+    p /= 10;
+    digits--;
+  }
+  pow10 = p;
+  return digits;
+}
+
+// moves the last digit towards the value while staying within the interval
+inline void roundWeed(char* buffer, int length, uint64_t dist, uint64_t delta,
+                      uint64_t rest, uint64_t ten_k)
+{
+  while (rest < dist && delta - rest >= ten_k &&
+         (rest + ten_k < dist || dist - rest > rest + ten_k - dist))
+  {
+    buffer[length - 1]--;
+    rest += ten_k;
+  }
+}
+
+// generates the shortest digits within [m_minus, m_plus]
+void generateDigits(char* buffer, int& length, int& exponent,
+                    const DiyFp& m_minus, const DiyFp& w, const DiyFp& m_plus)
+{
+  uint64_t delta = subtract(m_plus, m_minus).f;
+  uint64_t dist = subtract(m_plus, w).f;
+
+  // split m_plus into the integral part p1 and the fractional part p2
+  DiyFp one{ uint64_t(1) << -m_plus.e, m_plus.e };
+  uint32_t p1 = static_cast<uint32_t>(m_plus.f >> -one.e);
+  uint64_t p2 = m_plus.f & (one.f - 1);
+
+  uint32_t pow10;
+  int n = largestPow10(p1, pow10);
+  while (n > 0)
+  {
+    uint32_t digit = p1 / pow10;
+    p1 %= pow10;
+    buffer[length++] = static_cast<char>('0' + digit);
+    n--;
+
+    uint64_t rest = (static_cast<uint64_t>(p1) << -one.e) + p2;
+    if (rest <= delta)
+    {
+      exponent += n;
+      roundWeed(buffer, length, dist, delta, rest,
+                static_cast<uint64_t>(pow10) << -one.e);
+      return;
+    }
+    pow10 /= 10;
+  }
+
+  int m = 0;
+  while (true)
+  {
+    p2 *= 10;
+    uint64_t digit = p2 >> -one.e;
+    p2 &= one.f - 1;
+    buffer[length++] = static_cast<char>('0' + digit);
+    m++;
+
+    delta *= 10;
+    dist *= 10;
+    if (p2 <= delta)
+    {
+      break;
+    }
+  }
+  exponent -= m;
+  roundWeed(buffer, length, dist, delta, p2, one.f);
+}
+
+// shortest digits of a positive value, value = digits * 10^exponent
+void grisu2(char* buffer, int& length, int& exponent, double value)
+{
+  Boundaries b = computeBoundaries(value);
+  CachedPower cached = cachedPower(b.plus.e);
+  DiyFp c{ cached.f, cached.e };
+
+  DiyFp w = multiply(b.w, c);
+  DiyFp w_minus = multiply(b.minus, c);
+  DiyFp w_plus = multiply(b.plus, c);
+
+  // stay clear of the boundaries, as the products are approximations
+  DiyFp m_minus{ w_minus.f + 1, w_minus.e };
+  DiyFp m_plus{ w_plus.f - 1, w_plus.e };
+
+  length = 0;
+  exponent = -cached.k;
+  generateDigits(buffer, length, exponent, m_minus, w, m_plus);
+}
+
+// writes digits * 10^exponent in the same notation as %g
+char* formatDigits(char* buffer, const char* digits, int length, int exponent)
+{
+  int point = length + exponent; // position of the decimal point
+  int sci_exponent = point - 1;
+
+  if (sci_exponent >= -4 && sci_exponent < 17)
+  {
+    if (exponent >= 0)
+    {
+      // integral value
+      std::memcpy(buffer, digits, length);
+      buffer += length;
+      std::memset(buffer, '0', exponent);
+      return buffer + exponent;
+    }
+    else if (point > 0)
+    {
+      std::memcpy(buffer, digits, point);
+      buffer += point;
+      *buffer++ = '.';
+      std::memcpy(buffer, digits + point, length - point);
+      return buffer + (length - point);
+    }
+    *buffer++ = '0';
+    *buffer++ = '.';
+    std::memset(buffer, '0', -point);
+    buffer += -point;
+    std::memcpy(buffer, digits, length);
+    return buffer + length;
+  }
+
+  *buffer++ = digits[0];
+  if (length > 1)
+  {
+    *buffer++ = '.';
+    std::memcpy(buffer, digits + 1, length - 1);
+    buffer += length - 1;
+  }
+  *buffer++ = 'e';
+  if (sci_exponent < 0)
+  {
+    *buffer++ = '-';
+    sci_exponent = -sci_exponent;
+  }
+  else
+  {
+    *buffer++ = '+';
+  }
+
+  // at least two exponent digits
+  char exp_digits[4];
+  char* exp_begin = writeDigitsBackwards(exp_digits + 4, sci_exponent);
+  if (sci_exponent < 10)
+  {
+    *--exp_begin = '0';
+  }
+  std::memcpy(buffer, exp_begin, exp_digits + 4 - exp_begin);
+  return buffer + (exp_digits + 4 - exp_begin);
+}
+
+} // unnamed namespace
+
+char* formatInteger(char* buffer, Int value)
+{
+  // the unsigned negation also covers the lowest value
+  uint64_t abs_value = static_cast<uint64_t>(value);
+  if (value < 0)
+  {
+    *buffer++ = '-';
+    abs_value = 0 - abs_value;
+  }
+
+  char digits[20];
+  char* begin = writeDigitsBackwards(digits + sizeof(digits), abs_value);
+  std::size_t length = digits + sizeof(digits) - begin;
+  std::memcpy(buffer, begin, length);
+  return buffer + length;
+}
+
+char* formatShortest(char* buffer, Float value)
+{
+  if (std::signbit(value))
+  {
+    *buffer++ = '-';
+    value = -value;
+  }
+  if (value == 0.0)
+  {
+    *buffer++ = '0';
+    return buffer;
+  }
+
+  char digits[24];
+  int length;
+  int exponent;
+  grisu2(digits, length, exponent, value);
+  return formatDigits(buffer, digits, length, exponent);
+}
+
+char* formatPrecision(char* buffer, Float value, unsigned precision)
+{
+  int length = std::snprintf(buffer, precision + k_max_number_length, "%.*g",
+                             static_cast<int>(precision), value);
+
+  // the decimal point of the C locale is not necessarily '.'
+  for (int i = 0; i < length; ++i)
+  {
+    char c = buffer[i];
+    if ((c < '0' || c > '9') && c != '-' && c != '+' && c != 'e')
+    {
+      buffer[i] = '.';
+    }
+  }
+  return buffer + length;
+}
+
+bool isIntegerText(const char* begin, const char* end)
+{
+  if (begin != end && *begin == '-')
+  {
+    ++begin;
+  }
+  for (; begin != end; ++begin)
+  {
+    if (*begin < '0' || *begin > '9')
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace detail
+} // namespace cpds
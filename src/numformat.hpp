@@ -0,0 +1,58 @@
+/*
+ * numformat.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include "cpds/typedefs.hpp"
+
+namespace cpds {
+namespace detail {
+
+/**
+ * Locale-independent number formatting for the exporters.
+ *
+ * The functions write into a caller-provided buffer and return one past the
+ * last character written; no memory is allocated.
+ **/
+
+/**
+ * Upper bound of the output of formatInteger() and formatShortest().
+ **/
+constexpr std::size_t k_max_number_length = 32;
+
+/**
+ * Decimal representation of the integer.
+ **/
+char* formatInteger(char* buffer, Int value);
+
+/**
+ * Representation that parses back to the identical value (Grisu2). The digits
+ * are the shortest possible ones for all but a tiny fraction of values, which
+ * get one extra digit.
+ * Fixed notation is used for decimal exponents in [-4, 17), scientific
+ * notation (e.g. 1.5e+300) otherwise. The value must be finite.
+ **/
+char* formatShortest(char* buffer, Float value);
+
+/**
+ * Same as printf("%.*g", precision, value), but always with '.' as decimal
+ * point. The buffer must provide precision + k_max_number_length bytes.
+ **/
+char* formatPrecision(char* buffer, Float value, unsigned precision);
+
+/**
+ * Returns whether the formatted number consists of (signed) digits only,
+ * i.e. whether a floating point number would be read back as integer.
+ **/
+bool isIntegerText(const char* begin, const char* end);
+
+} // namespace detail
+} // namespace cpds
@@ -0,0 +1,151 @@
+/*
+ * outputfile.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "outputfile.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cpds/exception.hpp"
+
+namespace cpds {
+namespace detail {
+
+// enforce local linkage
+namespace {
+
+// distinguishes the temporary files of concurrent writers in one process
+std::atomic<unsigned> s_tmp_counter(0);
+
+String directoryOf(const String& path)
+{
+  std::size_t pos = path.rfind('/');
+  if (pos == String::npos)
+  {
+    return ".";
+  }
+  else if (pos == 0)
+  {
+    return "/";
+  }
+  return path.substr(0, pos);
+}
+
+} // unnamed namespace
+
+OutputFile::OutputFile(const String& path, bool atomic)
+  : path_(path)
+{
+  if (atomic)
+  {
+    openTemporary();
+    return;
+  }
+
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd_ < 0)
+  {
+    fail("cannot open", path_);
+  }
+}
+
+OutputFile::~OutputFile() noexcept
+{
+  if (fd_ >= 0)
+  {
+    ::close(fd_);
+  }
+  if (!tmp_path_.empty())
+  {
+    ::unlink(tmp_path_.c_str());
+  }
+}
+
+void OutputFile::commit()
+{
+  if (tmp_path_.empty())
+  {
+    int fd = fd_;
+    fd_ = -1;
+    if (::close(fd) != 0)
+    {
+      fail("cannot write", path_);
+    }
+    return;
+  }
+
+  // the data must be on disk before the rename makes it visible
+  if (::fsync(fd_) != 0)
+  {
+    fail("cannot sync", tmp_path_);
+  }
+  int fd = fd_;
+  fd_ = -1;
+  if (::close(fd) != 0)
+  {
+    fail("cannot write", tmp_path_);
+  }
+  if (std::rename(tmp_path_.c_str(), path_.c_str()) != 0)
+  {
+    fail("cannot rename", tmp_path_);
+  }
+  tmp_path_.clear();
+
+  // persist the directory entry as well, failures here do not affect the
+  // content seen by readers
+  int dir_fd = ::open(directoryOf(path_).c_str(),
+                      O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd >= 0)
+  {
+    ::fsync(dir_fd);
+    ::close(dir_fd);
+  }
+}
+
+void OutputFile::openTemporary()
+{
+  String prefix = path_ + ".tmp" + std::to_string(::getpid()) + "_";
+  while (fd_ < 0)
+  {
+    tmp_path_ = prefix + std::to_string(s_tmp_counter++);
+    fd_ = ::open(tmp_path_.c_str(),
+                 O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd_ < 0 && errno != EEXIST)
+    {
+      String tmp_path;
+      tmp_path.swap(tmp_path_); // nothing to remove
+      fail("cannot create", tmp_path);
+    }
+  }
+
+  // keep the permissions of the file that is replaced
+  struct stat target;
+  if (::stat(path_.c_str(), &target) == 0)
+  {
+    ::fchmod(fd_, target.st_mode & 07777);
+  }
+}
+
+void OutputFile::fail(const char* action, const String& path) const
+{
+  int error = errno;
+  String msg(action);
+  msg += " '";
+  msg += path;
+  msg += "': ";
+  msg += std::strerror(error);
+  throw Exception(msg);
+}
+
+} // namespace detail
+} // namespace cpds
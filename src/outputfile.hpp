@@ -0,0 +1,55 @@
+/*
+ * outputfile.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include "cpds/typedefs.hpp"
+
+namespace cpds {
+namespace detail {
+
+/**
+ * File that is written through a POSIX file descriptor.
+ *
+ * In atomic mode, the data goes to a temporary file in the same directory.
+ * commit() syncs it to disk and renames it over the target, such that
+ * readers observe either the previous or the complete new content. The
+ * temporary file takes over the permissions of an existing target.
+ *
+ * Without commit(), the destructor removes the temporary file.
+ * Errors are reported through exceptions.
+ **/
+class OutputFile
+{
+public:
+  OutputFile(const String& path, bool atomic);
+  ~OutputFile() noexcept;
+
+  OutputFile(const OutputFile&) = delete;
+  OutputFile& operator=(const OutputFile&) = delete;
+
+  int fd() const { return fd_; }
+
+  /**
+   * Completes the file. Must be called once all data is written.
+   **/
+  void commit();
+
+private:
+  void openTemporary();
+  [[noreturn]] void fail(const char* action, const String& path) const;
+
+  String path_;
+  String tmp_path_; // empty unless atomic
+  int fd_ = -1;
+}; // class OutputFile
+
+} // namespace detail
+} // namespace cpds
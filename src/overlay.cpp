@@ -0,0 +1,254 @@
+/*
+ * overlay.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "cpds/overlay.hpp"
+#include <algorithm>
+#include "cpds/exception.hpp"
+
+namespace cpds {
+
+// enforce local linkage
+namespace {
+
+struct MapCompare
+{
+  bool operator()(const MapEntry& a, const String& key) const
+  {
+    return a.first < key;
+  }
+}; // struct MapCompare
+
+inline bool isContainer(const Node& node)
+{
+  return (node.isSequence() || node.isMap());
+}
+
+} // unnamed namespace
+
+//
+// OverlayView implementation
+//
+
+OverlayView::OverlayView(const Node& node)
+  : layers_({ &node })
+{
+}
+
+OverlayView::OverlayView(std::vector<const Node*> layers)
+  : layers_(std::move(layers))
+{
+  init();
+}
+
+OverlayView::OverlayView(
+    std::initializer_list<std::reference_wrapper<const Node>> layers)
+{
+  layers_.reserve(layers.size());
+  for (const Node& node : layers)
+  {
+    layers_.push_back(&node);
+  }
+  init();
+}
+
+std::size_t OverlayView::size() const
+{
+  if (isSequence())
+  {
+    std::size_t size = 0;
+    for (const Node* layer : layers_)
+    {
+      size = std::max(size, layer->size());
+    }
+    return size;
+  }
+  else if (isMap())
+  {
+    std::size_t size = 0;
+    for (const_iterator iter = begin(); iter != end(); ++iter)
+    {
+      size++;
+    }
+    return size;
+  }
+  return 0;
+}
+
+OverlayView OverlayView::operator[](std::size_t index) const
+{
+  top().sequence(); // throws for non-sequence types
+
+  std::vector<const Node*> children;
+  for (const Node* layer : layers_)
+  {
+    const Sequence& seq = layer->sequence();
+    if (index < seq.size())
+    {
+      children.push_back(&seq[index]);
+    }
+  }
+
+  if (children.empty())
+  {
+    throw KeyException(std::to_string(index), top());
+  }
+  return OverlayView(std::move(children));
+}
+
+OverlayView OverlayView::at(const String& key) const
+{
+  const_iterator iter = find(key);
+  if (iter == end())
+  {
+    throw KeyException(key, top());
+  }
+  return iter.value();
+}
+
+OverlayView::const_iterator OverlayView::find(const String& key) const
+{
+  std::vector<Map::const_iterator> positions;
+  positions.reserve(layers_.size());
+  for (const Node* layer : layers_)
+  {
+    const Map& map = layer->map();
+    positions.push_back(std::lower_bound(map.begin(), map.end(), key,
+                                         MapCompare()));
+  }
+
+  const_iterator iter(&layers_, std::move(positions));
+  if (iter.key_ != nullptr && *iter.key_ == key)
+  {
+    return iter;
+  }
+  return end();
+}
+
+OverlayView::const_iterator OverlayView::begin() const
+{
+  std::vector<Map::const_iterator> positions;
+  positions.reserve(layers_.size());
+  for (const Node* layer : layers_)
+  {
+    positions.push_back(layer->map().begin());
+  }
+  return const_iterator(&layers_, std::move(positions));
+}
+
+OverlayView::const_iterator OverlayView::end() const
+{
+  std::vector<Map::const_iterator> positions;
+  positions.reserve(layers_.size());
+  for (const Node* layer : layers_)
+  {
+    positions.push_back(layer->map().end());
+  }
+  return const_iterator(&layers_, std::move(positions));
+}
+
+Node OverlayView::materialize() const
+{
+  Node node = *layers_.front();
+  node.merge(std::vector<const Node*>(layers_.begin()+1, layers_.end()));
+  return node;
+}
+
+void OverlayView::init()
+{
+  if (layers_.empty())
+  {
+    throw Exception("overlay view requires at least one layer");
+  }
+
+  // the same rules as for Node::merge() apply between consecutive layers
+  for (std::size_t i = 1; i < layers_.size(); ++i)
+  {
+    const Node& prev = *layers_[i-1];
+    const Node& cur = *layers_[i];
+    if (prev.type() != cur.type() && (isContainer(prev) || isContainer(cur)))
+    {
+      throw TypeException(cur);
+    }
+  }
+
+  // only the topmost scalar is visible
+  if (top().isScalar())
+  {
+    layers_.erase(layers_.begin(), layers_.end()-1);
+  }
+}
+
+//
+// OverlayView::const_iterator implementation
+//
+
+OverlayView::const_iterator::const_iterator(
+    const std::vector<const Node*>* layers,
+    std::vector<Map::const_iterator> positions)
+  : layers_(layers)
+  , positions_(std::move(positions))
+  , key_(nullptr)
+{
+  update();
+}
+
+OverlayEntry OverlayView::const_iterator::operator*() const
+{
+  return OverlayEntry{ *key_, value() };
+}
+
+OverlayView OverlayView::const_iterator::value() const
+{
+  std::vector<const Node*> children;
+  for (std::size_t i = 0; i < positions_.size(); ++i)
+  {
+    if (positions_[i] != (*layers_)[i]->map().end() &&
+        positions_[i]->first == *key_)
+    {
+      children.push_back(&positions_[i]->second);
+    }
+  }
+  return OverlayView(std::move(children));
+}
+
+OverlayView::const_iterator& OverlayView::const_iterator::operator++()
+{
+  for (std::size_t i = 0; i < positions_.size(); ++i)
+  {
+    if (positions_[i] != (*layers_)[i]->map().end() &&
+        positions_[i]->first == *key_)
+    {
+      ++positions_[i];
+    }
+  }
+  update();
+  return *this;
+}
+
+bool OverlayView::const_iterator::operator==(const const_iterator& other) const
+{
+  return (layers_ == other.layers_ && positions_ == other.positions_);
+}
+
+void OverlayView::const_iterator::update()
+{
+  // the current key is the smallest key of all layers
+  key_ = nullptr;
+  for (std::size_t i = 0; i < positions_.size(); ++i)
+  {
+    if (positions_[i] != (*layers_)[i]->map().end() &&
+        (key_ == nullptr || positions_[i]->first < *key_))
+    {
+      key_ = &positions_[i]->first;
+    }
+  }
+}
+
+} // namespace cpds
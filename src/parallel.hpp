@@ -0,0 +1,140 @@
+/*
+ * parallel.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <system_error>
+#include <algorithm>
+#include "cpds/typedefs.hpp"
+
+namespace cpds {
+namespace detail {
+
+/**
+ * Returns the number of worker threads to use for the requested count.
+ * A request of 0 threads selects the hardware concurrency.
+ **/
+inline unsigned resolveThreads(unsigned num_threads)
+{
+  if (num_threads == 0)
+  {
+    num_threads = std::thread::hardware_concurrency();
+  }
+  return std::max(num_threads, 1u);
+}
+
+/**
+ * Splits [0, count) into consecutive ranges and invokes fcn(begin, end) for
+ * each range on its own thread. The calling thread processes the first range.
+ *
+ * If any invocation throws, the exception of the lowest range is rethrown
+ * after all threads have been joined.
+ **/
+template <typename Fcn>
+void parallelFor(std::size_t count, unsigned num_threads, Fcn fcn)
+{
+  std::size_t num_ranges = std::min<std::size_t>(resolveThreads(num_threads),
+                                                 count);
+  if (num_ranges <= 1)
+  {
+    fcn(std::size_t(0), count);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(num_ranges);
+  std::vector<std::thread> threads;
+  threads.reserve(num_ranges-1);
+
+  auto run = [&](std::size_t range)
+  {
+    std::size_t begin = (count * range) / num_ranges;
+    std::size_t end = (count * (range+1)) / num_ranges;
+    try
+    {
+      fcn(begin, end);
+    }
+    catch (...)
+    {
+      errors[range] = std::current_exception();
+    }
+  };
+
+  for (std::size_t range = 1; range < num_ranges; ++range)
+  {
+    try
+    {
+      threads.emplace_back(run, range);
+    }
+    catch (const std::system_error&)
+    {
+      run(range); // no more threads available, fall back to this one
+    }
+  }
+  run(0);
+
+  for (std::thread& t : threads)
+  {
+    t.join();
+  }
+
+  for (const std::exception_ptr& e : errors)
+  {
+    if (e)
+    {
+      std::rethrow_exception(e);
+    }
+  }
+}
+
+/**
+ * Serializes the items [0, count) into text chunks on up to num_threads
+ * threads, for large containers.
+ *
+ * chunk(begin, end, str) writes the items [begin, end) into str. emit(chunks)
+ * receives the chunks of each round in order; their concatenation over all
+ * rounds covers the items in order. Working in rounds of one chunk per thread
+ * bounds the memory held by the chunks to a fraction of the whole output.
+ **/
+template <typename ChunkFcn, typename EmitFcn>
+void parallelChunks(std::size_t count, unsigned num_threads, ChunkFcn chunk,
+                    EmitFcn emit)
+{
+  constexpr std::size_t k_rounds = 8;
+
+  std::size_t num_chunks_per_round = resolveThreads(num_threads);
+  std::size_t num_chunks = std::min(count, num_chunks_per_round * k_rounds);
+  std::vector<String> chunks;
+  for (std::size_t first = 0; first < num_chunks;
+       first += num_chunks_per_round)
+  {
+    std::size_t num_round_chunks = std::min(num_chunks_per_round,
+                                            num_chunks - first);
+    chunks.resize(num_round_chunks);
+    parallelFor(num_round_chunks, num_threads,
+                [&](std::size_t begin, std::size_t end)
+    {
+      for (std::size_t i = begin; i < end; ++i)
+      {
+        std::size_t c = first + i;
+        chunks[i].clear();
+        chunk((count * c) / num_chunks, (count * (c+1)) / num_chunks,
+              chunks[i]);
+      }
+    });
+    emit(chunks);
+  }
+}
+
+} // namespace detail
+} // namespace cpds
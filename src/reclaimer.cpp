@@ -0,0 +1,124 @@
+/*
+ * reclaimer.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "cpds/reclaimer.hpp"
+
+namespace cpds {
+
+Reclaimer::Reclaimer(Mode mode)
+  : mode_(mode)
+{
+  if (mode_ == Mode::Background)
+  {
+    thread_ = std::thread(&Reclaimer::run, this);
+  }
+}
+
+Reclaimer::~Reclaimer()
+{
+  if (thread_.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+  }
+  collect();
+}
+
+void Reclaimer::retire(Node&& node)
+{
+  // scalars without heap data are cheap to destroy in place
+  if (node.isScalar() && !node.isString())
+  {
+    Node discard(std::move(node));
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(std::move(node));
+    num_retired_++;
+  }
+  if (mode_ == Mode::Background)
+  {
+    wakeup_.notify_one();
+  }
+}
+
+std::size_t Reclaimer::collect()
+{
+  // the pending list continues with the capacity of the previous batch
+  std::vector<Node> batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch.swap(spare_);
+    batch.swap(pending_);
+  }
+
+  std::size_t count = batch.size();
+  batch.clear(); // the actual destruction happens here, without the lock
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (batch.capacity() > spare_.capacity())
+    {
+      spare_.swap(batch);
+    }
+    num_reclaimed_ += count;
+  }
+  done_.notify_all();
+  return count;
+}
+
+void Reclaimer::flush()
+{
+  if (mode_ == Mode::Deferred)
+  {
+    collect();
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::size_t target = num_retired_;
+  done_.wait(lock, [&]() { return num_reclaimed_ >= target; });
+}
+
+std::size_t Reclaimer::pending() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_retired_ - num_reclaimed_;
+}
+
+Reclaimer& Reclaimer::global()
+{
+  static Reclaimer reclaimer(Mode::Background);
+  return reclaimer;
+}
+
+void Reclaimer::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    wakeup_.wait(lock, [this]() { return stop_ || !pending_.empty(); });
+    if (pending_.empty())
+    {
+      return; // stop requested and no work left
+    }
+    lock.unlock();
+    collect();
+    lock.lock();
+  }
+}
+
+} // namespace cpds
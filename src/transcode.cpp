@@ -0,0 +1,326 @@
+/*
+ * transcode.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "cpds/transcode.hpp"
+#include <unordered_map>
+#include <vector>
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#include <yaml-cpp/yaml.h>
+#include <yaml-cpp/eventhandler.h>
+#pragma GCC diagnostic pop
+#include "cpds/exception.hpp"
+#include "cpds/json.hpp"
+#include "writebuffer.hpp"
+#include "yamlscalar.hpp"
+#include "yamlwriter.hpp"
+
+namespace cpds {
+
+// enforce local linkage
+namespace {
+
+// parser event within an anchored subtree, without the anchor
+struct Event
+{
+  enum class Type
+  {
+    Null,
+    Scalar,
+    SequenceStart,
+    SequenceEnd,
+    MapStart,
+    MapEnd,
+  }; // enum class Type
+
+  Type type;
+  YAML::Mark mark;
+  String tag;
+  String value;
+}; // struct Event
+
+typedef std::vector<Event> EventList;
+
+// passes the YAML parser events to a JsonWriter
+class JsonTranscoder : public YAML::EventHandler
+{
+public:
+  explicit JsonTranscoder(JsonWriter& writer)
+    : writer_(writer)
+  {
+  }
+
+  void OnDocumentStart(const YAML::Mark&) override {}
+  void OnDocumentEnd() override {}
+
+  void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override
+  {
+    record(Event{Event::Type::Null, mark, String(), String()}, anchor);
+    if (isKey())
+    {
+      key(String()); // empty key, as in "? : value"
+      return;
+    }
+    valueDone();
+    writer_.null();
+  }
+
+  void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) override
+  {
+    auto iter = anchors_.find(anchor);
+    if (iter == anchors_.end())
+    {
+      // unknown anchor, or an alias within the anchored node itself
+      raise("invalid alias", mark);
+    }
+
+    // the replayed events are recorded by enclosing anchored subtrees
+    EventList events = iter->second;
+    for (const Event& event : events)
+    {
+      replay(event);
+    }
+  }
+
+  void OnScalar(const YAML::Mark& mark, const std::string& tag,
+                YAML::anchor_t anchor, const std::string& value) override
+  {
+    record(Event{Event::Type::Scalar, mark, tag, value}, anchor);
+    if (isKey())
+    {
+      key(value);
+      return;
+    }
+    writeScalar(tag, value);
+  }
+
+  void OnSequenceStart(const YAML::Mark& mark, const std::string&,
+                       YAML::anchor_t anchor,
+                       YAML::EmitterStyle::value) override
+  {
+    begin(Event{Event::Type::SequenceStart, mark, String(), String()}, anchor);
+    writer_.beginSequence();
+  }
+
+  void OnSequenceEnd() override
+  {
+    end(Event::Type::SequenceEnd);
+    writer_.endSequence();
+  }
+
+  void OnMapStart(const YAML::Mark& mark, const std::string&,
+                  YAML::anchor_t anchor,
+                  YAML::EmitterStyle::value) override
+  {
+    begin(Event{Event::Type::MapStart, mark, String(), String()}, anchor);
+    writer_.beginMap();
+  }
+
+  void OnMapEnd() override
+  {
+    end(Event::Type::MapEnd);
+    writer_.endMap();
+  }
+
+private:
+  // container that is being transcoded
+  struct Frame
+  {
+    bool is_map;
+    bool has_key;
+  }; // struct Frame
+
+  // anchored subtree that is being recorded
+  struct Capture
+  {
+    YAML::anchor_t anchor;
+    unsigned depth;
+    EventList events;
+  }; // struct Capture
+
+  void replay(const Event& event)
+  {
+    switch (event.type)
+    {
+    case Event::Type::Null:
+      OnNull(event.mark, YAML::NullAnchor);
+      break;
+    case Event::Type::Scalar:
+      OnScalar(event.mark, event.tag, YAML::NullAnchor, event.value);
+      break;
+    case Event::Type::SequenceStart:
+      OnSequenceStart(event.mark, event.tag, YAML::NullAnchor,
+                      YAML::EmitterStyle::Default);
+      break;
+    case Event::Type::SequenceEnd:
+      OnSequenceEnd();
+      break;
+    case Event::Type::MapStart:
+      OnMapStart(event.mark, event.tag, YAML::NullAnchor,
+                 YAML::EmitterStyle::Default);
+      break;
+    case Event::Type::MapEnd:
+      OnMapEnd();
+      break;
+    }
+  }
+
+  // adds a scalar event to the recordings, and records it for the anchor
+  void record(const Event& event, YAML::anchor_t anchor)
+  {
+    for (Capture& capture : captures_)
+    {
+      capture.events.push_back(event);
+    }
+    if (anchor != YAML::NullAnchor)
+    {
+      anchors_[anchor] = EventList(1, event);
+    }
+  }
+
+  void begin(const Event& event, YAML::anchor_t anchor)
+  {
+    if (isKey())
+    {
+      raise("map keys must be scalars", event.mark);
+    }
+
+    for (Capture& capture : captures_)
+    {
+      capture.events.push_back(event);
+      capture.depth++;
+    }
+    if (anchor != YAML::NullAnchor)
+    {
+      captures_.push_back(Capture{anchor, 1, EventList(1, event)});
+    }
+    stack_.push_back(Frame{event.type == Event::Type::MapStart, false});
+  }
+
+  void end(Event::Type type)
+  {
+    stack_.pop_back();
+    valueDone();
+
+    Event event{type, YAML::Mark(), String(), String()};
+    for (Capture& capture : captures_)
+    {
+      capture.events.push_back(event);
+      capture.depth--;
+    }
+
+    // the captures are nested, only the innermost one can be complete
+    if (!captures_.empty() && captures_.back().depth == 0)
+    {
+      Capture& capture = captures_.back();
+      anchors_[capture.anchor] = std::move(capture.events);
+      captures_.pop_back();
+    }
+  }
+
+  void writeScalar(const std::string& tag, const String& str)
+  {
+    valueDone();
+
+    // quoted scalars ("!") and explicit strings are not resolved
+    if (tag == "!" || tag == "tag:yaml.org,2002:str")
+    {
+      writer_.value(str);
+      return;
+    }
+
+    detail::YamlScalar scalar = cache_.resolve(str);
+    switch (scalar.type)
+    {
+    case NodeType::Null:
+      writer_.null();
+      break;
+    case NodeType::Boolean:
+      writer_.value(scalar.bool_value);
+      break;
+    case NodeType::Integer:
+      writer_.value(scalar.int_value);
+      break;
+    case NodeType::FloatingPoint:
+      writer_.value(scalar.float_value);
+      break;
+    default:
+      writer_.value(str);
+      break;
+    }
+  }
+
+  // whether the next event provides a map key
+  bool isKey() const
+  {
+    return (!stack_.empty() && stack_.back().is_map && !stack_.back().has_key);
+  }
+
+  void key(const String& key)
+  {
+    stack_.back().has_key = true;
+    writer_.key(key);
+  }
+
+  // the value of the current map entry is complete
+  void valueDone()
+  {
+    if (!stack_.empty() && stack_.back().is_map)
+    {
+      stack_.back().has_key = false;
+    }
+  }
+
+  [[noreturn]] void raise(const char* msg, const YAML::Mark& mark) const
+  {
+    throw ImportException(msg, nullptr, mark.line+1, mark.column+1);
+  }
+
+  JsonWriter& writer_;
+  std::vector<Frame> stack_;
+  std::vector<Capture> captures_;
+  std::unordered_map<YAML::anchor_t, EventList> anchors_;
+  detail::YamlScalarCache cache_;
+}; // class JsonTranscoder
+
+} // unnamed namespace
+
+void jsonToYaml(std::istream& in, std::ostream& out)
+{
+  detail::WriteBuffer buffer(out);
+  detail::YamlWriter writer(buffer);
+  JsonImport().parse(in, writer);
+  buffer.flush();
+}
+
+void yamlToJson(std::istream& in, std::ostream& out, unsigned indent,
+                unsigned precision)
+{
+  JsonWriter writer(out, indent, precision);
+  JsonTranscoder transcoder(writer);
+  YAML::Parser parser(in);
+  try
+  {
+    parser.HandleNextDocument(transcoder);
+  }
+  catch (YAML::Exception& e)
+  {
+    throw ImportException(nullptr, e.mark.line+1, e.mark.column+1);
+  }
+
+  // an empty stream or a scalar document is not a JSON object
+  if (!writer.complete())
+  {
+    throw TypeException();
+  }
+  writer.flush();
+}
+
+} // namespace cpds
@@ -9,25 +9,22 @@
  */
 
 #include "cpds/validator.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 #include "cpds/node.hpp"
 #include "cpds/exception.hpp"
-
-#include <iostream>
+#include "parallel.hpp"
 
 namespace cpds {
 
 // enforce local linkage
 namespace {
 
-// accepts nodes that match the type
-void vType(const Node& node,
-           const Validator& validator)
-{
-  if (node.type() != validator.type())
-  {
-    throw TypeException(node);
-  }
-}
+// range of integers that convert to floating point numbers, see Node
+constexpr Int k_max_float_int = (1ull<<53);
+constexpr Int k_min_float_int = -k_max_float_int;
 
 // accepts all maps
 GroupEnableResult vAllMaps(const Node& /*node*/)
@@ -35,96 +32,426 @@ GroupEnableResult vAllMaps(const Node& /*node*/)
   return Check;
 }
 
+// accepts nodes that match the type
+bool cType(const Node& node, const Validator& validator,
+           ValidationResult& result)
+{
+  if (node.type() != validator.type())
+  {
+    return result.typeError(node);
+  }
+  return true;
+}
+
 // integer range validator
-void vIntRange(const Node& node,
-               const Validator& validator)
+bool cIntRange(const Node& node, const Validator& validator,
+               ValidationResult& result)
 {
-  IntRange range = validator.intRange();
+  if (!node.isInt())
+  {
+    return result.typeError(node);
+  }
+  const IntRange& range = validator.intRange();
   Int val = node.intValue();
   if (val < range.first || val > range.second)
   {
-    throw IntRangeException(range.first, range.second, val, node);
+    return result.intRangeError(range.first, range.second, val, node);
   }
+  return true;
 }
 
 // floating point range validator
-void vFloatRange(const Node& node,
-                 const Validator& validator)
+bool cFloatRange(const Node& node, const Validator& validator,
+                 ValidationResult& result)
 {
-  FloatRange range = validator.floatRange();
-  Float val = node.floatValue();
+  // same conversion as Node::floatValue(), without the exception
+  Float val;
+  if (node.isFloat())
+  {
+    val = node.floatValue();
+  }
+  else if (node.isInt() && node.intValue() >= k_min_float_int &&
+           node.intValue() <= k_max_float_int)
+  {
+    val = static_cast<Float>(node.intValue());
+  }
+  else
+  {
+    return result.typeError(node);
+  }
+
+  const FloatRange& range = validator.floatRange();
   if (val < range.first || val > range.second)
   {
-    throw FloatRangeException(range.first, range.second, val, node);
+    return result.floatRangeError(range.first, range.second, val, node);
   }
+  return true;
+}
+
+// minimum number of children that are checked on multiple threads
+constexpr std::size_t k_parallel_check_threshold = 1024;
+
+// Runs check(i, result) for the indices [0, count) on up to num_threads
+// threads and returns the lowest index that fails, or count. Its failure is
+// stored in result. The indices beyond a known failure are skipped.
+template <typename CheckFcn>
+std::size_t checkConcurrently(std::size_t count, unsigned num_threads,
+                              CheckFcn check, ValidationResult& result)
+{
+  std::atomic<std::size_t> first_failure(count);
+  std::mutex mutex; // protects result
+  detail::parallelFor(count, num_threads,
+                      [&](std::size_t begin, std::size_t end)
+  {
+    ValidationResult local;
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      if (i > first_failure.load(std::memory_order_relaxed))
+      {
+        return;
+      }
+      if (!check(i, local))
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (i < first_failure.load(std::memory_order_relaxed))
+        {
+          first_failure.store(i, std::memory_order_relaxed);
+          result = local;
+        }
+        return;
+      }
+    }
+  });
+  return first_failure.load();
+}
+
+// whether any of the validators accepts the child, their failures are not
+// reported
+bool checkAny(const Node& child, const ValidatorVector& validators,
+              ValidationResult& alternative, unsigned num_threads)
+{
+  for (const Validator& vld : validators)
+  {
+    if (vld.check(child, alternative, num_threads))
+    {
+      return true;
+    }
+  }
+  return false;
 }
 
 // sequence validator
-void vSequence(const Node& node,
-               const Validator& validator)
+bool cSequence(const Node& node, const Validator& validator,
+               ValidationResult& result, unsigned num_threads)
 {
   const ValidatorVector& validators = validator.seqValidators();
   if (validators.empty())
   {
-    return; // nothing to validate against
+    return true; // nothing to validate against
+  }
+  if (!node.isSequence())
+  {
+    return result.typeError(node);
+  }
+
+  const Sequence& seq = node.sequence();
+  if (seq.size() >= k_parallel_check_threshold &&
+      detail::resolveThreads(num_threads) > 1)
+  {
+    // each child is checked on a single thread
+    std::size_t failed = checkConcurrently(seq.size(), num_threads,
+                                           [&](std::size_t i,
+                                               ValidationResult& local)
+    {
+      ValidationResult alternative;
+      return (checkAny(seq[i], validators, alternative, 1) ||
+              local.failure("sequence child failed to validate", seq[i]));
+    }, result);
+    return (failed == seq.size());
   }
 
-  for (const Node& child : node.sequence())
+  // the failures of the alternatives are not reported
+  ValidationResult alternative;
+  for (const Node& child : seq)
   {
     // any of the validators must succeed
-    bool success = false;
-    for (const Validator& vld : validators)
+    if (!checkAny(child, validators, alternative, num_threads))
     {
-      try
+      return result.failure("sequence child failed to validate", child);
+    }
+  }
+  return true;
+}
+
+// Merges the map with the sorted entries of the group, and reports missing
+// required keys and extra keys. The matched values are passed to
+// value(validator, node), which returns false on failure.
+template <typename ValueFcn>
+bool mergeGroup(const MapGroup& group, const Node& node,
+                ValidationResult& result, ValueFcn value)
+{
+  // Both the map and the entries are sorted by key, a single merge pass
+  // finds the values, the missing required keys and the extra keys. An
+  // entry key may appear more than once, its value is then matched again.
+  bool closed = (group.closedness() == NoMoreEntries);
+  const Map& map = node.map();
+  Map::const_iterator iter = map.begin();
+  bool is_matched = false; // whether iter matched an entry
+  for (const MapEntryType& entry : group.entries())
+  {
+    while (iter != map.end() && iter->first < entry.key())
+    {
+      if (closed && !is_matched)
       {
-        vld.validate(child);
-        success = true;
-        break;
+        return result.extraKey(iter->first, node);
       }
-      catch (...)
+      ++iter;
+      is_matched = false;
+    }
+
+    if (iter != map.end() && iter->first == entry.key())
+    {
+      if (!value(entry.validator(), iter->second))
       {
+        return false;
       }
+      is_matched = true;
+    }
+    else if (entry.requiredness() == Required)
+    {
+      return result.failure("required key not present", node);
     }
+  }
 
-    if (!success)
+  // the remaining keys are extra
+  if (closed && iter != map.end())
+  {
+    if (is_matched)
+    {
+      ++iter;
+    }
+    if (iter != map.end())
     {
-      throw ValidationException("sequence child failed to validate", child);
+      return result.extraKey(iter->first, node);
     }
   }
+  return true;
+}
+
+// The built-in validation functions throw the failure of the checks above.
+// They also identify the built-in validators in Validator::check().
+void vType(const Node& node,
+           const Validator& validator)
+{
+  ValidationResult result;
+  if (!cType(node, validator, result))
+  {
+    result.raise();
+  }
+}
+
+void vIntRange(const Node& node,
+               const Validator& validator)
+{
+  ValidationResult result;
+  if (!cIntRange(node, validator, result))
+  {
+    result.raise();
+  }
+}
+
+void vFloatRange(const Node& node,
+                 const Validator& validator)
+{
+  ValidationResult result;
+  if (!cFloatRange(node, validator, result))
+  {
+    result.raise();
+  }
+}
+
+void vSequence(const Node& node,
+               const Validator& validator)
+{
+  ValidationResult result;
+  if (!cSequence(node, validator, result, 1))
+  {
+    result.raise();
+  }
 }
 
-// map validator
 void vMap(const Node& node,
           const Validator& validator)
 {
-  const MapGroupVector& groups = validator.mapGroups();
-  if (groups.empty())
+  ValidationResult result;
+  if (!validator.check(node, result))
   {
-    return; // nothing to validate against
+    result.raise();
   }
+}
 
-  bool matched = false; // at least one group must match
-  for (const MapGroup& group : groups)
+} // unnamed namespace
+
+// the groups of a map validator, with the groups that have a discriminator
+// indexed by its value
+struct Validator::MapData
+{
+  // groups with the same discriminator key
+  struct Dispatch
   {
-    GroupEnableResult result = group.check(node);
-    if (result == Invalid)
+    String key;
+    std::unordered_map<String, std::vector<std::size_t>> groups;
+  }; // struct Dispatch
+
+  explicit MapData(MapGroupVector map_groups);
+
+  MapGroupVector groups;
+  std::vector<std::size_t> checked; // groups without discriminator
+  std::vector<Dispatch> dispatch;
+}; // struct Validator::MapData
+
+Validator::MapData::MapData(MapGroupVector map_groups)
+  : groups(std::move(map_groups))
+{
+  for (std::size_t i = 0; i < groups.size(); ++i)
+  {
+    const MapGroup& group = groups[i];
+    if (!group.hasDiscriminator())
     {
+      checked.push_back(i);
       continue;
     }
-    else if (result == Check)
+
+    // there are usually only one or very few discriminator keys
+    auto iter = std::find_if(dispatch.begin(), dispatch.end(),
+                             [&](const Dispatch& d)
     {
-      group.validate(node);
+      return d.key == group.discriminatorKey();
+    });
+    if (iter == dispatch.end())
+    {
+      dispatch.push_back(Dispatch{group.discriminatorKey(), {}});
+      iter = dispatch.end() - 1;
     }
-    matched = true;
-  } // loop
+    iter->groups[group.discriminatorValue()].push_back(i);
+  }
+}
 
-  if (matched == false)
+//
+// ValidationResult implementation
+//
+
+String ValidationResult::message() const
+{
+  if (valid())
   {
-    throw ValidationException("map does not match any validation group", node);
+    return String();
   }
+
+  // the messages are the ones of the exceptions
+  try
+  {
+    raise();
+  }
+  catch (const Exception& e)
+  {
+    return e.message();
+  }
+  catch (const std::exception& e)
+  {
+    return e.what();
+  }
+  catch (...)
+  {
+  }
+  return "unknown exception";
 }
 
-} // unnamed namespace
+void ValidationResult::raise() const
+{
+  switch (error_)
+  {
+  case Error::None:
+    break;
+  case Error::Type:
+    throw TypeException(*node_);
+  case Error::IntRange:
+    throw IntRangeException(int_min_, int_max_, int_actual_, *node_);
+  case Error::FloatRange:
+    throw FloatRangeException(float_min_, float_max_, float_actual_, *node_);
+  case Error::Validation:
+    if (key_ != nullptr)
+    {
+      String msg("extra key '");
+      msg += *key_;
+      msg += ("' present in map");
+      throw ValidationException(msg, *node_);
+    }
+    throw ValidationException(msg_, *node_);
+  case Error::Exception:
+    std::rethrow_exception(exception_);
+  }
+  throw Exception("API error: no validation failure");
+}
+
+void ValidationResult::clear()
+{
+  *this = ValidationResult();
+}
+
+bool ValidationResult::typeError(const Node& node)
+{
+  error_ = Error::Type;
+  node_ = &node;
+  return false;
+}
+
+bool ValidationResult::intRangeError(Int min, Int max, Int actual,
+                                     const Node& node)
+{
+  error_ = Error::IntRange;
+  node_ = &node;
+  int_min_ = min;
+  int_max_ = max;
+  int_actual_ = actual;
+  return false;
+}
+
+bool ValidationResult::floatRangeError(Float min, Float max, Float actual,
+                                       const Node& node)
+{
+  error_ = Error::FloatRange;
+  node_ = &node;
+  float_min_ = min;
+  float_max_ = max;
+  float_actual_ = actual;
+  return false;
+}
+
+bool ValidationResult::failure(const char* msg, const Node& node)
+{
+  error_ = Error::Validation;
+  node_ = &node;
+  msg_ = msg;
+  key_ = nullptr;
+  return false;
+}
+
+bool ValidationResult::extraKey(const String& key, const Node& node)
+{
+  error_ = Error::Validation;
+  node_ = &node;
+  key_ = &key;
+  return false;
+}
+
+bool ValidationResult::exceptionError(std::exception_ptr exception)
+{
+  error_ = Error::Exception;
+  node_ = nullptr;
+  exception_ = std::move(exception);
+  return false;
+}
 
 //
 // Validator implementation
@@ -162,7 +489,7 @@ Validator::Validator(MapGroupVector map_groups)
   : type_(NodeType::Map)
   , fcn_(vMap)
 {
-  aux_data_.map_groups_ = new MapGroupVector(std::move(map_groups));
+  aux_data_.map_data_ = new MapData(std::move(map_groups));
 }
 
 Validator::Validator(const Validator& other)
@@ -189,8 +516,7 @@ Validator::Validator(const Validator& other)
         new ValidatorVector(*other.aux_data_.seq_validators_);
     break;
   case NodeType::Map:
-    aux_data_.map_groups_ =
-        new MapGroupVector(*other.aux_data_.map_groups_);
+    aux_data_.map_data_ = new MapData(*other.aux_data_.map_data_);
     break;
   default:
     break;
@@ -226,16 +552,62 @@ Validator::~Validator()
     delete aux_data_.seq_validators_;
     break;
   case NodeType::Map:
-    delete aux_data_.map_groups_;
+    delete aux_data_.map_data_;
     break;
   default:
     break;
   }
 }
 
-void Validator::validate(const Node& node) const
+void Validator::validate(const Node& node, unsigned num_threads) const
 {
-  fcn_(node, *this);
+  ValidationResult result;
+  if (!check(node, result, num_threads))
+  {
+    result.raise();
+  }
+}
+
+bool Validator::check(const Node& node, ValidationResult& result,
+                      unsigned num_threads) const
+{
+  if (fcn_ == vType)
+  {
+    return cType(node, *this, result);
+  }
+  else if (fcn_ == vIntRange)
+  {
+    return cIntRange(node, *this, result);
+  }
+  else if (fcn_ == vFloatRange)
+  {
+    return cFloatRange(node, *this, result);
+  }
+  else if (fcn_ == vSequence)
+  {
+    return cSequence(node, *this, result, num_threads);
+  }
+  else if (fcn_ == vMap)
+  {
+    return checkMap(node, result, num_threads);
+  }
+
+  // custom functions report failures by throwing
+  try
+  {
+    fcn_(node, *this);
+    return true;
+  }
+  catch (...)
+  {
+    return result.exceptionError(std::current_exception());
+  }
+}
+
+bool Validator::isBuiltin() const
+{
+  return (fcn_ == vType || fcn_ == vIntRange || fcn_ == vFloatRange ||
+          fcn_ == vSequence || fcn_ == vMap);
 }
 
 const IntRange& Validator::intRange() const
@@ -267,7 +639,7 @@ const ValidatorVector& Validator::seqValidators() const
 const MapGroupVector& Validator::mapGroups() const
 {
   checkType(NodeType::Map);
-  return *aux_data_.map_groups_;
+  return aux_data_.map_data_->groups;
 }
 
 void Validator::swap(Validator& other) noexcept
@@ -285,6 +657,73 @@ void Validator::checkType(NodeType type) const
   }
 }
 
+bool Validator::checkMap(const Node& node, ValidationResult& result,
+                         unsigned num_threads) const
+{
+  const MapData& data = *aux_data_.map_data_;
+  if (data.groups.empty())
+  {
+    return true; // nothing to validate against
+  }
+
+  bool matched = false; // at least one group must match
+  for (std::size_t index : data.checked)
+  {
+    const MapGroup& group = data.groups[index];
+    GroupEnableResult enable;
+    try
+    {
+      enable = group.check(node);
+    }
+    catch (...)
+    {
+      return result.exceptionError(std::current_exception());
+    }
+
+    if (enable == Invalid)
+    {
+      continue;
+    }
+    else if (enable == Check && !group.validate(node, result, num_threads))
+    {
+      return false;
+    }
+    matched = true;
+  } // loop
+
+  if (!data.dispatch.empty() && !node.isMap())
+  {
+    return result.typeError(node);
+  }
+  for (const MapData::Dispatch& dispatch : data.dispatch)
+  {
+    Map::const_iterator value = node.find(dispatch.key);
+    if (value == node.end() || !value->second.isString())
+    {
+      continue;
+    }
+    auto iter = dispatch.groups.find(value->second.stringValue());
+    if (iter == dispatch.groups.end())
+    {
+      continue;
+    }
+    for (std::size_t index : iter->second)
+    {
+      if (!data.groups[index].validate(node, result, num_threads))
+      {
+        return false;
+      }
+      matched = true;
+    }
+  }
+
+  if (matched == false)
+  {
+    return result.failure("map does not match any validation group", node);
+  }
+  return true;
+}
+
 //
 // NullType implementation
 //
@@ -418,16 +857,30 @@ MapEntryType::MapEntryType(String key,
 
 void MapEntryType::validate(const Node& node) const
 {
+  ValidationResult result;
+  if (!validate(node, result))
+  {
+    result.raise();
+  }
+}
+
+bool MapEntryType::validate(const Node& node, ValidationResult& result) const
+{
+  if (!node.isMap())
+  {
+    return result.typeError(node);
+  }
+
   Map::const_iterator iter = node.find(key_);
   if (iter == node.end())
   {
     if (requiredness_ == Optional)
     {
-      return;
+      return true;
     }
-    throw ValidationException("required key not present", node);
+    return result.failure("required key not present", node);
   }
-  validator_.validate(iter->second);
+  return validator_.check(iter->second, result);
 }
 
 //
@@ -446,49 +899,157 @@ MapGroup::MapGroup(MapEntryTypeVector entries,
   , closedness_(closedness)
   , enable_fcn_(enable_fcn)
 {
+  if (enable_fcn_ == nullptr)
+  {
+    throw Exception("API error: missing group enable function");
+  }
+  sortEntries();
+}
+
+MapGroup::MapGroup(MapEntryTypeVector entries,
+                   Closedness closedness,
+                   String discriminator_key,
+                   String discriminator_value)
+  : entries_(std::move(entries))
+  , closedness_(closedness)
+  , enable_fcn_(nullptr)
+  , has_discriminator_(true)
+  , discriminator_key_(std::move(discriminator_key))
+  , discriminator_value_(std::move(discriminator_value))
+{
+  sortEntries();
+  auto iter = std::lower_bound(entries_.begin(), entries_.end(),
+                               discriminator_key_,
+                               [](const MapEntryType& a, const String& key)
+  {
+    return a.key() < key;
+  });
+  if (iter == entries_.end() || iter->key() != discriminator_key_)
+  {
+    entries_.insert(iter, MapEntryType(discriminator_key_, StringType(),
+                                       Required));
+  }
 }
 
 GroupEnableResult MapGroup::check(const Node& node) const
 {
-  return enable_fcn_(node);
+  if (!has_discriminator_)
+  {
+    return enable_fcn_(node);
+  }
+
+  // same selection as by MapType
+  if (!node.isMap())
+  {
+    return Invalid;
+  }
+  Map::const_iterator value = node.find(discriminator_key_);
+  if (value != node.end() && value->second.isString() &&
+      value->second.stringValue() == discriminator_value_)
+  {
+    return Check;
+  }
+  return Invalid;
 }
 
 void MapGroup::validate(const Node& node) const
 {
-  for (const MapEntryType& entry : entries_)
+  ValidationResult result;
+  if (!validate(node, result))
   {
-    entry.validate(node);
+    result.raise();
   }
+}
 
-  // ensure there are no other entries
-  if (closedness_ == AllowMoreEntries)
+bool MapGroup::validate(const Node& node, ValidationResult& result,
+                        unsigned num_threads) const
+{
+  bool closed = (closedness_ == NoMoreEntries);
+  if (entries_.empty() && !closed)
+  {
+    return true;
+  }
+  if (!node.isMap())
   {
-    return;
+    return result.typeError(node);
   }
 
-  const Map& map = node.map();
-  for (const MapEntry& entry : map)
+  if (node.size() < 2 || detail::resolveThreads(num_threads) <= 1)
   {
-    const String& key = entry.first;
-    bool found = false;
-    for (const MapEntryType& type : entries_)
+    return mergeGroup(*this, node, result,
+                      [&](const Validator& validator, const Node& value)
     {
-      if (type.key() == key)
-      {
-        found = true;
-        break;
-      }
-    } // entry type loop
+      return validator.check(value, result, num_threads);
+    });
+  }
 
-    if (!found)
+  // The merge pass only collects the values. As it stops at its first
+  // failure, the failure of any collected value precedes it.
+  std::vector<std::pair<const Validator*, const Node*>> values;
+  ValidationResult merge_result;
+  bool merged = mergeGroup(*this, node, merge_result,
+                           [&](const Validator& validator, const Node& value)
+  {
+    values.emplace_back(&validator, &value);
+    return true;
+  });
+
+  // Small values are checked concurrently on a single thread each, if
+  // there is enough work. Large values use all threads on their own.
+  std::vector<std::size_t> small;
+  std::size_t weight = 0;
+  for (std::size_t i = 0; i < values.size(); ++i)
+  {
+    std::size_t size = values[i].second->size();
+    if (size < k_parallel_check_threshold)
     {
-      String msg("extra key '");
-      msg += key;
-      msg += ("' present in map");
-      throw ValidationException(msg, node);
+      small.push_back(i);
+      weight += size + 1;
     }
+  }
+  unsigned small_threads = (weight >= k_parallel_check_threshold) ?
+                           num_threads : 1;
+  std::size_t failed = checkConcurrently(small.size(), small_threads,
+                                         [&](std::size_t i,
+                                             ValidationResult& local)
+  {
+    const auto& pair = values[small[i]];
+    return pair.first->check(*pair.second, local, 1);
+  }, result);
+  std::size_t first_failure = (failed < small.size()) ? small[failed] :
+                                                         values.size();
+
+  // only the large values before the first failure matter
+  for (std::size_t i = 0; i < first_failure; ++i)
+  {
+    const Node& value = *values[i].second;
+    if (value.size() >= k_parallel_check_threshold &&
+        !values[i].first->check(value, result, num_threads))
+    {
+      return false;
+    }
+  }
 
-  } // map loop
+  if (first_failure < values.size())
+  {
+    return false;
+  }
+  else if (!merged)
+  {
+    result = merge_result;
+    return false;
+  }
+  return true;
+}
+
+void MapGroup::sortEntries()
+{
+  // same order as the map, see validate()
+  std::stable_sort(entries_.begin(), entries_.end(),
+                   [](const MapEntryType& a, const MapEntryType& b)
+  {
+    return a.key() < b.key();
+  });
 }
 
 } // namespace cpds
@@ -0,0 +1,401 @@
+/*
+ * validatorprogram.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "cpds/validatorprogram.hpp"
+#include <algorithm>
+#include <iterator>
+#include "cpds/node.hpp"
+#include "cpds/exception.hpp"
+
+namespace cpds {
+
+// enforce local linkage
+namespace {
+
+// range of integers that convert to floating point numbers, see Node
+constexpr Int k_max_float_int = (1ull<<53);
+constexpr Int k_min_float_int = -k_max_float_int;
+
+// same conversion as Node::floatValue(), without exceptions
+bool toFloat(const Node& node, Float& value)
+{
+  if (node.isFloat())
+  {
+    value = node.floatValue();
+    return true;
+  }
+  else if (node.isInt())
+  {
+    Int val = node.intValue();
+    if (val >= k_min_float_int && val <= k_max_float_int)
+    {
+      value = static_cast<Float>(val);
+      return true;
+    }
+  }
+  return false;
+}
+
+} // unnamed namespace
+
+ValidatorProgram::ValidatorProgram(const Validator& validator)
+  : validator_(new Validator(validator))
+{
+  compile(*validator_);
+}
+
+ValidatorProgram::ValidatorProgram(ValidatorProgram&& other) noexcept =
+    default;
+
+ValidatorProgram& ValidatorProgram::operator=(ValidatorProgram&& other)
+    noexcept = default;
+
+ValidatorProgram::~ValidatorProgram() = default;
+
+void ValidatorProgram::validate(const Node& node) const
+{
+  ValidationResult result;
+  if (!check(node, result))
+  {
+    result.raise();
+  }
+}
+
+bool ValidatorProgram::check(const Node& node, ValidationResult& result) const
+{
+  return run(0, node, result);
+}
+
+uint32_t ValidatorProgram::compile(const Validator& validator)
+{
+  // the children are compiled after their parent, which is completed once
+  // their instructions are known
+  uint32_t pc = static_cast<uint32_t>(code_.size());
+  code_.push_back(Instruction{Op::Custom, validator.type(), 0, 0, 0, 0, 0, 0,
+                              0.0, 0.0, &validator});
+  if (!validator.isBuiltin())
+  {
+    return pc;
+  }
+
+  switch (validator.type())
+  {
+  case NodeType::Integer:
+    if (validator.validationFcn() == IntegerType().validationFcn())
+    {
+      code_[pc].op = Op::Type;
+      break;
+    }
+    code_[pc].op = Op::IntRange;
+    code_[pc].int_min = validator.intRange().first;
+    code_[pc].int_max = validator.intRange().second;
+    break;
+  case NodeType::FloatingPoint:
+    if (validator.validationFcn() == FloatingPointType().validationFcn())
+    {
+      code_[pc].op = Op::Type;
+      break;
+    }
+    code_[pc].op = Op::FloatRange;
+    code_[pc].float_min = validator.floatRange().first;
+    code_[pc].float_max = validator.floatRange().second;
+    break;
+  case NodeType::Sequence:
+  {
+    std::vector<uint32_t> pcs;
+    for (const Validator& child : validator.seqValidators())
+    {
+      pcs.push_back(compile(child));
+    }
+    code_[pc].op = Op::Sequence;
+    code_[pc].begin = static_cast<uint32_t>(alternatives_.size());
+    code_[pc].count = static_cast<uint32_t>(pcs.size());
+    alternatives_.insert(alternatives_.end(), pcs.begin(), pcs.end());
+    break;
+  }
+  case NodeType::Map:
+    compileMap(pc, validator.mapGroups());
+    break;
+  default:
+    code_[pc].op = Op::Type;
+    break;
+  }
+  return pc;
+}
+
+void ValidatorProgram::compileMap(uint32_t pc,
+                                  const MapGroupVector& map_groups)
+{
+  // the groups without discriminator come first, they are checked in turn
+  std::vector<const MapGroup*> order;
+  for (const MapGroup& group : map_groups)
+  {
+    if (!group.hasDiscriminator())
+    {
+      order.push_back(&group);
+    }
+  }
+  std::size_t num_checked = order.size();
+  for (const MapGroup& group : map_groups)
+  {
+    if (group.hasDiscriminator())
+    {
+      order.push_back(&group);
+    }
+  }
+
+  // the map group keeps its entries sorted by key, the groups refer to the
+  // local entries until the nested maps have appended theirs
+  std::vector<Group> groups;
+  std::vector<Entry> entries;
+  for (const MapGroup* group : order)
+  {
+    std::size_t begin = entries.size();
+    for (const MapEntryType& entry : group->entries())
+    {
+      entries.push_back(Entry{entry.key(), entry.requiredness(),
+                              compile(entry.validator())});
+    }
+    groups.push_back(Group{static_cast<uint32_t>(begin),
+                           static_cast<uint32_t>(entries.size() - begin),
+                           group->closedness(), group->enableFcn()});
+  }
+  uint32_t first_entry = static_cast<uint32_t>(entries_.size());
+  for (Group& group : groups)
+  {
+    group.begin += first_entry;
+  }
+
+  uint32_t first_group = static_cast<uint32_t>(groups_.size());
+  std::vector<Dispatch> dispatch;
+  for (std::size_t i = num_checked; i < order.size(); ++i)
+  {
+    const String& key = order[i]->discriminatorKey();
+    auto iter = std::find_if(dispatch.begin(), dispatch.end(),
+                             [&](const Dispatch& d) { return d.key == key; });
+    if (iter == dispatch.end())
+    {
+      dispatch.push_back(Dispatch{key, {}});
+      iter = dispatch.end() - 1;
+    }
+    iter->groups[order[i]->discriminatorValue()].push_back(
+        first_group + static_cast<uint32_t>(i));
+  }
+
+  Instruction& ins = code_[pc];
+  ins.op = Op::Map;
+  ins.begin = first_group;
+  ins.count = static_cast<uint32_t>(num_checked);
+  ins.dispatch_begin = static_cast<uint32_t>(dispatch_.size());
+  ins.dispatch_count = static_cast<uint32_t>(dispatch.size());
+  groups_.insert(groups_.end(), groups.begin(), groups.end());
+  std::move(entries.begin(), entries.end(), std::back_inserter(entries_));
+  std::move(dispatch.begin(), dispatch.end(), std::back_inserter(dispatch_));
+}
+
+bool ValidatorProgram::run(uint32_t pc, const Node& node,
+                           ValidationResult& result) const
+{
+  const Instruction& ins = code_[pc];
+  switch (ins.op)
+  {
+  case Op::Type:
+    return (node.type() == ins.type || result.typeError(node));
+  case Op::IntRange:
+  {
+    if (!node.isInt())
+    {
+      return result.typeError(node);
+    }
+    Int val = node.intValue();
+    if (val < ins.int_min || val > ins.int_max)
+    {
+      return result.intRangeError(ins.int_min, ins.int_max, val, node);
+    }
+    return true;
+  }
+  case Op::FloatRange:
+  {
+    Float val;
+    if (!toFloat(node, val))
+    {
+      return result.typeError(node);
+    }
+    if (val < ins.float_min || val > ins.float_max)
+    {
+      return result.floatRangeError(ins.float_min, ins.float_max, val, node);
+    }
+    return true;
+  }
+  case Op::Sequence:
+    return runSequence(ins, node, result);
+  case Op::Map:
+    return runMap(ins, node, result);
+  case Op::Custom:
+    return ins.validator->check(node, result);
+  }
+  return true;
+}
+
+bool ValidatorProgram::runSequence(const Instruction& ins, const Node& node,
+                                   ValidationResult& result) const
+{
+  if (ins.count == 0)
+  {
+    return true; // nothing to validate against
+  }
+  if (!node.isSequence())
+  {
+    return result.typeError(node);
+  }
+
+  // the failures of the alternatives are not reported
+  ValidationResult alternative;
+  const uint32_t* begin = &alternatives_[ins.begin];
+  const uint32_t* end = begin + ins.count;
+  for (const Node& child : node.sequence())
+  {
+    // any of the alternatives must succeed
+    const uint32_t* alt = begin;
+    while (alt != end && !run(*alt, child, alternative))
+    {
+      ++alt;
+    }
+    if (alt == end)
+    {
+      return result.failure("sequence child failed to validate", child);
+    }
+  }
+  return true;
+}
+
+bool ValidatorProgram::runMap(const Instruction& ins, const Node& node,
+                              ValidationResult& result) const
+{
+  if (ins.count == 0 && ins.dispatch_count == 0)
+  {
+    return true; // nothing to validate against
+  }
+
+  bool matched = false; // at least one group must match
+  for (uint32_t i = ins.begin; i < ins.begin + ins.count; ++i)
+  {
+    const Group& group = groups_[i];
+    GroupEnableResult enable;
+    try
+    {
+      enable = group.enable_fcn(node);
+    }
+    catch (...)
+    {
+      return result.exceptionError(std::current_exception());
+    }
+
+    if (enable == Invalid)
+    {
+      continue;
+    }
+    else if (enable == Check && !runGroup(group, node, result))
+    {
+      return false;
+    }
+    matched = true;
+  }
+
+  if (ins.dispatch_count > 0 && !node.isMap())
+  {
+    return result.typeError(node);
+  }
+  for (uint32_t i = ins.dispatch_begin;
+       i < ins.dispatch_begin + ins.dispatch_count; ++i)
+  {
+    const Dispatch& dispatch = dispatch_[i];
+    Map::const_iterator value = node.find(dispatch.key);
+    if (value == node.end() || !value->second.isString())
+    {
+      continue;
+    }
+    auto iter = dispatch.groups.find(value->second.stringValue());
+    if (iter == dispatch.groups.end())
+    {
+      continue;
+    }
+    for (uint32_t index : iter->second)
+    {
+      if (!runGroup(groups_[index], node, result))
+      {
+        return false;
+      }
+      matched = true;
+    }
+  }
+
+  if (!matched)
+  {
+    return result.failure("map does not match any validation group", node);
+  }
+  return true;
+}
+
+bool ValidatorProgram::runGroup(const Group& group, const Node& node,
+                                ValidationResult& result) const
+{
+  bool closed = (group.closedness == NoMoreEntries);
+  if (group.count == 0 && !closed)
+  {
+    return true;
+  }
+  if (!node.isMap())
+  {
+    return result.typeError(node);
+  }
+
+  // merge join of the sorted map with the sorted entries
+  const Map& map = node.map();
+  Map::const_iterator iter = map.begin();
+  bool is_matched = false; // whether iter matched an entry
+  auto skipExtra = [&](const String* key) -> bool
+  {
+    while (iter != map.end() && (key == nullptr || iter->first < *key))
+    {
+      if (closed && !is_matched)
+      {
+        return result.extraKey(iter->first, node);
+      }
+      ++iter;
+      is_matched = false;
+    }
+    return true;
+  };
+
+  const Entry* end = entries_.data() + group.begin + group.count;
+  for (const Entry* entry = end - group.count; entry != end; ++entry)
+  {
+    if (!skipExtra(&entry->key))
+    {
+      return false;
+    }
+    if (iter != map.end() && iter->first == entry->key)
+    {
+      if (!run(entry->pc, iter->second, result))
+      {
+        return false;
+      }
+      is_matched = true;
+    }
+    else if (entry->requiredness == Required)
+    {
+      return result.failure("required key not present", node);
+    }
+  }
+  return skipExtra(nullptr);
+}
+
+} // namespace cpds
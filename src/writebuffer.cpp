@@ -0,0 +1,312 @@
+/*
+ * writebuffer.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "writebuffer.hpp"
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "cpds/exception.hpp"
+
+namespace cpds {
+namespace detail {
+
+WriteBuffer::WriteBuffer()
+{
+  setBlock(scratch_, k_scratch_size);
+}
+
+WriteBuffer::WriteBuffer(std::ostream& strm)
+  : strm_(&strm)
+  , block_(new char[k_block_size])
+{
+  setBlock(block_.get(), k_block_size);
+}
+
+WriteBuffer::WriteBuffer(String& str)
+  : str_(&str)
+{
+  // the data is appended to the existing content
+  std::size_t used = str.size();
+  attachString(used, std::max(str.capacity(), used + k_scratch_size));
+}
+
+WriteBuffer::WriteBuffer(int fd)
+  : fd_(fd)
+  , block_(new char[k_block_size])
+{
+  setBlock(block_.get(), k_block_size);
+}
+
+WriteBuffer::WriteBuffer(char* data, std::size_t capacity)
+{
+  if (capacity == 0)
+  {
+    setBlock(scratch_, k_scratch_size); // counts only
+    return;
+  }
+
+  // the output goes directly into the array until it is full
+  array_ = data;
+  array_end_ = data + capacity;
+  setBlock(data, capacity);
+}
+
+void WriteBuffer::writeChunks(const std::vector<String>& chunks)
+{
+  if (array_end_ != nullptr)
+  {
+    for (const String& chunk : chunks)
+    {
+      write(chunk);
+    }
+    return;
+  }
+  else if (str_ != nullptr)
+  {
+    std::size_t length = 0;
+    for (const String& chunk : chunks)
+    {
+      length += chunk.size();
+    }
+    if (length == 0)
+    {
+      return;
+    }
+    char* pos = reserve(length);
+    for (const String& chunk : chunks)
+    {
+      std::memcpy(pos, chunk.data(), chunk.size());
+      pos += chunk.size();
+    }
+    commit(length);
+    return;
+  }
+
+  drain();
+  for (const String& chunk : chunks)
+  {
+    flushed_ += chunk.size();
+    if (strm_ != nullptr)
+    {
+      strm_->write(chunk.data(), chunk.size());
+    }
+  }
+  if (fd_ >= 0)
+  {
+    writeFd(chunks);
+  }
+}
+
+void WriteBuffer::flush()
+{
+  if (str_ != nullptr)
+  {
+    // drop the unused tail, further writes re-attach to the string
+    if (begin_ == nullptr)
+    {
+      return; // already flushed
+    }
+    str_->resize(cur_ - begin_);
+    begin_ = cur_ = end_ = nullptr;
+    return;
+  }
+  drain();
+}
+
+void WriteBuffer::writeSlow(const char* data, std::size_t length)
+{
+  if (str_ != nullptr)
+  {
+    overflow(length);
+    std::memcpy(cur_, data, length);
+    cur_ += length;
+    return;
+  }
+
+  // large writes pass through the block in pieces
+  while (true)
+  {
+    std::size_t count = std::min<std::size_t>(end_ - cur_, length);
+    std::memcpy(cur_, data, count);
+    cur_ += count;
+    data += count;
+    length -= count;
+    if (length == 0)
+    {
+      return;
+    }
+    drain();
+  }
+}
+
+void WriteBuffer::fillSlow(char c, std::size_t count)
+{
+  if (str_ != nullptr)
+  {
+    overflow(count);
+    std::memset(cur_, c, count);
+    cur_ += count;
+    return;
+  }
+
+  while (true)
+  {
+    std::size_t n = std::min<std::size_t>(end_ - cur_, count);
+    std::memset(cur_, c, n);
+    cur_ += n;
+    count -= n;
+    if (count == 0)
+    {
+      return;
+    }
+    drain();
+  }
+}
+
+void WriteBuffer::overflow(std::size_t length)
+{
+  if (str_ != nullptr)
+  {
+    // grow the string geometrically
+    std::size_t used = (begin_ != nullptr) ? (cur_ - begin_) : str_->size();
+    attachString(used, std::max(2 * str_->size(), used + length));
+    return;
+  }
+
+  drain();
+  if (length > static_cast<std::size_t>(end_ - begin_))
+  {
+    // only reserve() requests more than a block at once
+    block_.reset(new char[length]);
+    setBlock(block_.get(), length);
+  }
+}
+
+void WriteBuffer::drain()
+{
+  std::size_t length = cur_ - begin_;
+  cur_ = begin_;
+  flushed_ += length;
+
+  if (strm_ != nullptr)
+  {
+    strm_->write(begin_, length);
+  }
+  else if (fd_ >= 0)
+  {
+    writeFd(begin_, length);
+  }
+  else if (array_end_ != nullptr)
+  {
+    writeArray(length);
+  }
+  // else counting only
+}
+
+void WriteBuffer::writeFd(const char* data, std::size_t length)
+{
+  // write() may be interrupted or accept only part of the data
+  const char* pos = data;
+  const char* end = data + length;
+  while (pos != end)
+  {
+    ssize_t written = ::write(fd_, pos, end - pos);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      throw Exception(String("write failed: ") + std::strerror(errno));
+    }
+    pos += written;
+  }
+}
+
+void WriteBuffer::writeFd(const std::vector<String>& chunks)
+{
+  std::vector<iovec> iov;
+  iov.reserve(chunks.size());
+  for (const String& chunk : chunks)
+  {
+    if (!chunk.empty())
+    {
+      iov.push_back(iovec{const_cast<char*>(chunk.data()), chunk.size()});
+    }
+  }
+
+  // as for write(), writev() may return early
+  std::size_t first = 0;
+  while (first < iov.size())
+  {
+    int count = static_cast<int>(std::min<std::size_t>(iov.size() - first,
+                                                       IOV_MAX));
+    ssize_t written = ::writev(fd_, &iov[first], count);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      throw Exception(String("write failed: ") + std::strerror(errno));
+    }
+
+    std::size_t remaining = static_cast<std::size_t>(written);
+    while (first < iov.size() && remaining >= iov[first].iov_len)
+    {
+      remaining -= iov[first].iov_len;
+      first++;
+    }
+    if (remaining > 0)
+    {
+      iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + remaining;
+      iov[first].iov_len -= remaining;
+    }
+  }
+}
+
+void WriteBuffer::writeArray(std::size_t length)
+{
+  if (begin_ == array_)
+  {
+    // the array is the block, the remaining output passes the scratch block
+    array_ = begin_ + length;
+    setBlock(scratch_, k_scratch_size);
+    return;
+  }
+
+  // the scratch block, or a larger one allocated by reserve()
+  std::size_t count = std::min<std::size_t>(length, array_end_ - array_);
+  if (count > 0)
+  {
+    std::memcpy(array_, begin_, count);
+    array_ += count;
+  }
+}
+
+void WriteBuffer::setBlock(char* begin, std::size_t size)
+{
+  begin_ = begin;
+  cur_ = begin;
+  end_ = begin + size;
+}
+
+void WriteBuffer::attachString(std::size_t used, std::size_t size)
+{
+  str_->resize(size);
+  setBlock(&(*str_)[0], size);
+  cur_ = begin_ + used;
+}
+
+} // namespace detail
+} // namespace cpds
@@ -0,0 +1,151 @@
+/*
+ * writebuffer.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "cpds/typedefs.hpp"
+
+namespace cpds {
+namespace detail {
+
+/**
+ * Output buffer of the exporters.
+ *
+ * The data is collected in a block and handed to the sink (std::ostream or
+ * file descriptor) in large chunks. A String sink is written in place, i.e.
+ * the string itself is the block and grows on demand. A fixed-size array
+ * receives the first bytes of the output, the rest is only counted. Without
+ * a sink, the data is only counted.
+ *
+ * The counting and array sinks do not allocate memory, provided that
+ * reserve() is called with at most k_scratch_size bytes.
+ *
+ * flush() must be called once the output is complete.
+ **/
+class WriteBuffer
+{
+public:
+  static constexpr std::size_t k_block_size = 64 * 1024;
+  static constexpr std::size_t k_scratch_size = 256;
+
+  WriteBuffer(); // counts only
+  explicit WriteBuffer(std::ostream& strm);
+  explicit WriteBuffer(String& str);
+  explicit WriteBuffer(int fd); // POSIX file descriptor
+  WriteBuffer(char* data, std::size_t capacity);
+
+  WriteBuffer(const WriteBuffer&) = delete;
+  WriteBuffer& operator=(const WriteBuffer&) = delete;
+
+  void put(char c);
+  void write(const char* data, std::size_t length);
+  void write(const String& str) { write(str.data(), str.size()); }
+  void fill(char c, std::size_t count);
+
+  /**
+   * Writes the strings in order. Stream and file descriptor sinks receive
+   * them directly, without a copy into the block.
+   **/
+  void writeChunks(const std::vector<String>& chunks);
+
+  /**
+   * Provides space for length bytes at the current position.
+   * commit() advances the position by the number of bytes actually used.
+   **/
+  char* reserve(std::size_t length);
+  void commit(std::size_t length) { cur_ += length; }
+
+  /**
+   * Hands the buffered data to the sink.
+   * Throws if writing to a file descriptor fails.
+   **/
+  void flush();
+
+  /**
+   * Returns the number of bytes written so far.
+   **/
+  std::size_t size() const { return flushed_ + (cur_ - begin_); }
+
+private:
+  void writeSlow(const char* data, std::size_t length);
+  void fillSlow(char c, std::size_t count);
+  void overflow(std::size_t length); // makes room for length bytes
+  void drain(); // hands the block to the sink
+  void writeFd(const char* data, std::size_t length);
+  void writeFd(const std::vector<String>& chunks);
+  void writeArray(std::size_t length);
+  void setBlock(char* begin, std::size_t size);
+  void attachString(std::size_t used, std::size_t size);
+
+  std::ostream* strm_ = nullptr;
+  String* str_ = nullptr;
+  int fd_ = -1;
+  std::unique_ptr<char[]> block_;
+  char* array_ = nullptr; // unused part of the array sink
+  char* array_end_ = nullptr;
+  std::size_t flushed_ = 0;
+
+  char* begin_ = nullptr;
+  char* cur_ = nullptr;
+  char* end_ = nullptr;
+
+  char scratch_[k_scratch_size]; // block of the counting and array sinks
+}; // class WriteBuffer
+
+//
+// inline implementations
+//
+
+inline void WriteBuffer::put(char c)
+{
+  if (cur_ == end_)
+  {
+    overflow(1);
+  }
+  *cur_++ = c;
+}
+
+inline void WriteBuffer::write(const char* data, std::size_t length)
+{
+  if (static_cast<std::size_t>(end_ - cur_) < length)
+  {
+    writeSlow(data, length);
+    return;
+  }
+  std::memcpy(cur_, data, length);
+  cur_ += length;
+}
+
+inline void WriteBuffer::fill(char c, std::size_t count)
+{
+  if (static_cast<std::size_t>(end_ - cur_) < count)
+  {
+    fillSlow(c, count);
+    return;
+  }
+  std::memset(cur_, c, count);
+  cur_ += count;
+}
+
+inline char* WriteBuffer::reserve(std::size_t length)
+{
+  if (static_cast<std::size_t>(end_ - cur_) < length)
+  {
+    overflow(length);
+  }
+  return cur_;
+}
+
+} // namespace detail
+} // namespace cpds
@@ -9,326 +9,659 @@
  */
 
 #include "cpds/yaml.hpp"
-#include <cmath>
-#include <cassert>
 #include <fstream>
+#include <iterator>
+#include <sstream>
+#include <streambuf>
+#include <unordered_map>
+#include <vector>
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 #include <yaml-cpp/yaml.h>
+#include <yaml-cpp/eventhandler.h>
 #pragma GCC diagnostic pop
 #include "cpds/node.hpp"
 #include "cpds/exception.hpp"
+#include "cpds/walker.hpp"
+#include "parallel.hpp"
+#include "writebuffer.hpp"
+#include "yamlformatter.hpp"
+#include "yamlscalar.hpp"
 
 namespace cpds {
 
-//
-// YamlExport implementation
-//
+// enforce local linkage
+namespace {
 
-void YamlExport::dump(std::ostream& strm, const Node& node)
+// minimum number of top-level children for parallel serialization
+constexpr std::size_t k_parallel_export_threshold = 64;
+
+// read-only stream buffer on existing memory
+class MemoryBuffer : public std::streambuf
 {
-  YAML::Emitter emitter(strm);
-  dumpNode(emitter, node);
-}
+public:
+  MemoryBuffer(char* begin, char* end)
+  {
+    setg(begin, begin, end);
+  }
+}; // class MemoryBuffer
 
-String YamlExport::dump(const Node& node)
+// part of a stream that starts at a document marker
+struct DocumentRange
 {
-  std::stringstream sstrm;
-  dump(sstrm, node);
-  return sstrm.str();
-}
+  std::size_t begin;
+  std::size_t end;
+  unsigned line; // number of lines before the range
+}; // struct DocumentRange
 
-void YamlExport::dumpNode(YAML::Emitter& emitter, const Node& node) const
+inline bool isSeparator(const String& text, std::size_t pos)
 {
-  switch (node.type())
-  {
-  case NodeType::Null:
-    // note: currently this will emit '~' rather than empty
-    emitter << YAML::_Null();
-    break;
-  case NodeType::Boolean:
-    emitter << node.boolValue();
-    break;
-  case NodeType::Integer:
-    emitter << node.intValue();
-    break;
-  case NodeType::FloatingPoint:
-    dumpFloat(emitter, node);
-    break;
-  case NodeType::String:
-    emitter << node.stringValue();
-    break;
-  case NodeType::Sequence:
-    dumpSequence(emitter, node);
-    break;
-  case NodeType::Map:
-    dumpMap(emitter, node);
-    break;
-  }
+  return (pos == text.size() || text[pos] == ' ' || text[pos] == '\t' ||
+          text[pos] == '\r' || text[pos] == '\n');
 }
 
-void YamlExport::dumpFloat(YAML::Emitter& emitter, const Node& node) const
+// Splits the stream before each '---' marker at the start of a line. Such a
+// line always ends the previous document (9.1 of YAML 1.2), even within a
+// block scalar. Returns false for streams with directives, which precede the
+// marker they belong to.
+bool splitDocuments(const String& text, std::vector<DocumentRange>& ranges)
 {
-  double value = node.floatValue();
-
-  if (std::isnan(value))
-  {
-    emitter << ".nan";
-  }
-  else if (std::isinf(value))
+  DocumentRange range{0, 0, 0};
+  unsigned line = 0;
+  std::size_t pos = 0;
+  while (pos < text.size())
   {
-    if (value < 0)
+    if (text[pos] == '%')
     {
-      emitter << "-.inf";
+      return false;
     }
-    else
+    if (text.compare(pos, 3, "---") == 0 && isSeparator(text, pos + 3) &&
+        pos > range.begin)
     {
-      emitter << ".inf";
+      range.end = pos;
+      ranges.push_back(range);
+      range = DocumentRange{pos, 0, line};
     }
+
+    // next line
+    pos = text.find('\n', pos);
+    if (pos == String::npos)
+    {
+      break;
+    }
+    pos++;
+    line++;
   }
-  else
-  {
-    emitter << value;
-  }
+
+  range.end = text.size();
+  ranges.push_back(range);
+  return true;
 }
 
-void YamlExport::dumpSequence(YAML::Emitter& emitter, const Node& node) const
+} // unnamed namespace
+
+//
+// YamlExport implementation
+//
+
+void YamlExport::dump(std::ostream& strm, const Node& node)
 {
-  emitter << YAML::BeginSeq;
-  for (const Node& n : node.sequence())
-  {
-    dumpNode(emitter, n);
-  }
-  emitter << YAML::EndSeq;
+  detail::WriteBuffer buffer(strm);
+  dumpNode(buffer, node);
+  buffer.flush();
 }
 
-void YamlExport::dumpMap(YAML::Emitter& emitter, const Node& node) const
+String YamlExport::dump(const Node& node)
 {
-  emitter << YAML::BeginMap;
-  for (const MapEntry& e : node.map())
-  {
-    emitter << YAML::Key;
-    emitter << e.first;
-    emitter << YAML::Value;
-    dumpNode(emitter, e.second);
-  }
-  emitter << YAML::EndMap;
+  String str;
+  detail::WriteBuffer buffer(str);
+  dumpNode(buffer, node);
+  buffer.flush();
+  return str;
 }
 
-//
-// YamlImport implementation
-//
+std::size_t YamlExport::dumpTo(char* data, std::size_t capacity,
+                               const Node& node) const
+{
+  detail::WriteBuffer buffer(data, capacity);
+  detail::YamlFormatter formatter(buffer);
+  detail::WalkFrame frames[detail::k_max_bounded_depth];
+  bool is_complete = detail::walkBounded(node, formatter, frames,
+                                         detail::k_max_bounded_depth);
+  buffer.flush();
+  return is_complete ? buffer.size() : 0;
+}
 
-Node YamlImport::load(std::istream& strm)
+void YamlExport::dumpAll(std::ostream& strm, const Sequence& documents)
 {
-  return load(strm, nullptr);
+  detail::WriteBuffer buffer(strm);
+  dumpDocuments(buffer, documents);
+  buffer.flush();
 }
 
-Node YamlImport::load(const String& str)
+String YamlExport::dumpAll(const Sequence& documents)
 {
-  std::stringstream sstrm(str);
-  return load(sstrm);
+  String str;
+  detail::WriteBuffer buffer(str);
+  dumpDocuments(buffer, documents);
+  buffer.flush();
+  return str;
 }
 
-Node YamlImport::loadFromFile(const String& filename)
+void YamlExport::dumpNode(detail::WriteBuffer& buffer, const Node& node) const
 {
-  std::ifstream fstrm(filename.c_str());
-  return load(fstrm, std::make_shared<String>(filename));
+  if (!node.isScalar() && node.size() >= k_parallel_export_threshold &&
+      detail::resolveThreads(num_threads_) > 1)
+  {
+    dumpChunked(buffer, node);
+    return;
+  }
+
+  detail::YamlFormatter formatter(buffer);
+  walk(node, formatter);
 }
 
-Node YamlImport::load(std::istream &strm, StringPtr filename)
+void YamlExport::dumpChunked(detail::WriteBuffer& buffer,
+                             const Node& node) const
 {
-  try
+  // The children of a top-level block collection are not indented, and all
+  // but the first start with a line break. A chunk therefore has the same
+  // text as within the complete document.
+  bool is_map = node.isMap();
+  bool is_flow = !is_map && detail::isFlowSequence(node);
+  if (is_flow)
+  {
+    buffer.put('[');
+  }
+  detail::parallelChunks(node.size(), num_threads_,
+                         [&](std::size_t begin, std::size_t end, String& str)
   {
-    // reset the parse info when the stream changes
-    if (strm_ != &strm)
+    detail::WriteBuffer chunk(str);
+    detail::YamlFormatter formatter(chunk);
+    formatter.setDepth(1);
+    for (std::size_t i = begin; i < end; ++i)
     {
-      strm_ = &strm;
-      parseinfo_.clear();
+      if (is_map)
+      {
+        const MapEntry& entry = node.map()[i];
+        formatter.key(entry.first, i);
+        walk(entry.second, formatter);
+      }
+      else if (is_flow)
+      {
+        if (i > 0)
+        {
+          chunk.write(", ", 2);
+        }
+        formatter.scalar(node.sequence()[i]);
+      }
+      else
+      {
+        formatter.element(i);
+        walk(node.sequence()[i], formatter);
+      }
     }
-    filename_ = filename;
-    return transform(YAML::Load(strm));
-  }
-  catch (YAML::Exception& e)
+    chunk.flush();
+  },
+  [&](const std::vector<String>& chunks)
   {
-    throw ImportException(nullptr, 0, 0);
+    buffer.writeChunks(chunks);
+  });
+  if (is_flow)
+  {
+    buffer.put(']');
   }
 }
 
-Node YamlImport::transform(const YAML::Node& node)
+void YamlExport::dumpDocuments(detail::WriteBuffer& buffer,
+                               const Sequence& documents) const
 {
-  Node n = doTransform(node);
-  const YAML::Mark mark = node.Mark();
-  ParseMark pm(filename_, mark.line+1, mark.column+1);
-  parseinfo_.insert(std::make_pair(n.id(), std::move(pm)));
-  return n;
-}
+  // each document is complete on its own, which makes it a natural chunk
+  auto write = [](detail::WriteBuffer& out, const Node& document)
+  {
+    out.write("---\n", 4);
+    detail::YamlFormatter formatter(out);
+    walk(document, formatter);
+    out.put('\n');
+  };
 
-Node YamlImport::doTransform(const YAML::Node& node)
-{
-  assert(node.IsDefined());
-  switch (node.Type())
-  {
-  case YAML::NodeType::Scalar:
-    return transformScalar(node);
-  case YAML::NodeType::Sequence:
-    return transformSequence(node);
-  case YAML::NodeType::Map:
-    return transformMap(node);
-  default:
-    return Node(); // null
+  if (documents.size() < 2 || detail::resolveThreads(num_threads_) == 1)
+  {
+    for (const Node& document : documents)
+    {
+      write(buffer, document);
+    }
+    return;
   }
-}
-
-Node YamlImport::transformScalar(const YAML::Node& node)
-{
-  //
-  // following the Core Schema (10.3 of YAML 1.2)
-  //
 
-  const String& str = node.Scalar();
+  detail::parallelChunks(documents.size(), num_threads_,
+                         [&](std::size_t begin, std::size_t end, String& str)
+  {
+    detail::WriteBuffer chunk(str);
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      write(chunk, documents[i]);
+    }
+    chunk.flush();
+  },
+  [&](const std::vector<String>& chunks)
+  {
+    buffer.writeChunks(chunks);
+  });
+}
 
-  //
-  // null
-  //
+//
+// YamlImport::Builder implementation
+//
 
-  if (str.empty() || str == "null" || str == "Null" ||
-      str == "NULL" || str == "~")
+class YamlImport::Builder : public YAML::EventHandler
+{
+public:
+  // the line numbers of the parse marks are increased by line_offset
+  Builder(StringPtr filename, ParseInfo& parseinfo, unsigned line_offset = 0)
+    : filename_(std::move(filename))
+    , parseinfo_(parseinfo)
+    , line_offset_(line_offset)
   {
-    return Node();
   }
 
-  //
-  // booleans
-  //
-
-  if (str == "true" || str == "True" || str == "TRUE")
+  // parses the next document, returns false at the end of the stream
+  bool parse(YAML::Parser& parser)
   {
-    return true;
+    try
+    {
+      return parser.HandleNextDocument(*this);
+    }
+    catch (YAML::Exception& e)
+    {
+      throw ImportException(filename_, line_offset_ + e.mark.line+1,
+                            e.mark.column+1);
+    }
   }
-  else if (str == "false" || str == "False" || str == "FALSE")
+
+  // the root node of the last document, null for an empty stream
+  Node result() { return std::move(root_); }
+
+  void OnDocumentStart(const YAML::Mark&) override
   {
-    return false;
+    anchors_.clear(); // anchors are local to a document
+    texts_.clear();
+    root_ = Node();
   }
 
-  //
-  // integers
-  //
+  void OnDocumentEnd() override {}
 
-  if (str[0] == '+' || str[0] == '-' ||
-      (str[0] >= '0' && str[0] <= '9'))
+  void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override
   {
-    try
+    if (isKey())
     {
-      std::size_t pos = 0;
-      Int intval = std::stoll(str, &pos, 10);
-      if (pos == str.size())
-      {
-        return intval;
-      }
+      setKey(String()); // empty key, as in "? : value"
+      completeKey(Node(), mark, anchor);
+      return;
     }
-    catch (const std::exception& e)
+    if (anchor != YAML::NullAnchor)
     {
-      // ignore
+      texts_[anchor] = String();
     }
+    complete(Node(), mark, anchor);
   }
 
-  if (str.size() >= 3 && str[0] == '0' && str[1] == 'o')
+  void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) override
   {
-    try
+    auto iter = anchors_.find(anchor);
+    if (iter == anchors_.end())
     {
-      String valstr = str.substr(2);
-      std::size_t pos = 0;
-      Int intval = std::stoll(valstr, &pos, 8);
-      if (pos == valstr.size())
+      // unknown anchor, or an alias within the anchored node itself
+      raise("invalid alias", mark);
+    }
+    if (isKey())
+    {
+      // the key is the text of the anchored scalar, as it would be for the
+      // scalar itself
+      auto text = texts_.find(anchor);
+      if (text == texts_.end())
       {
-        return intval;
+        raise("map keys must be scalars", mark);
       }
+      setKey(text->second);
+      return;
+    }
+
+    // the aliases share the anchored node, including its id and thus its
+    // parse mark
+    add(iter->second.share());
+  }
+
+  void OnScalar(const YAML::Mark& mark, const std::string& tag,
+                YAML::anchor_t anchor, const std::string& value) override
+  {
+    if (anchor != YAML::NullAnchor)
+    {
+      texts_[anchor] = value;
     }
-    catch (const std::exception& e)
+    if (isKey())
     {
-      // ignore
+      setKey(value);
+      completeKey(transformScalar(tag, value), mark, anchor);
+      return;
     }
+    complete(transformScalar(tag, value), mark, anchor);
   }
 
-  if (str.size() >= 3 && str[0] == '0' && str[1] == 'x')
+  void OnSequenceStart(const YAML::Mark& mark, const std::string&,
+                       YAML::anchor_t anchor,
+                       YAML::EmitterStyle::value) override
   {
-    try
+    begin(false, mark, anchor);
+  }
+
+  void OnSequenceEnd() override
+  {
+    end();
+  }
+
+  void OnMapStart(const YAML::Mark& mark, const std::string&,
+                  YAML::anchor_t anchor,
+                  YAML::EmitterStyle::value) override
+  {
+    begin(true, mark, anchor);
+  }
+
+  void OnMapEnd() override
+  {
+    end();
+  }
+
+private:
+  // container that is being parsed
+  struct Frame
+  {
+    ParseMark mark;
+    YAML::anchor_t anchor;
+    bool is_map;
+    bool has_key;
+    Sequence seq;
+    Map map;
+    String key; // key of the current map entry
+  }; // struct Frame
+
+  Node transformScalar(const std::string& tag, const String& str)
+  {
+    // quoted scalars ("!") and explicit strings are not resolved
+    if (tag == "!" || tag == "tag:yaml.org,2002:str")
     {
-      String valstr = str.substr(2);
-      std::size_t pos = 0;
-      Int intval = std::stoll(valstr, &pos, 16);
-      if (pos == valstr.size())
-      {
-        return intval;
-      }
+      return str;
     }
-    catch (const std::exception& e)
+
+    detail::YamlScalar scalar = cache_.resolve(str);
+    switch (scalar.type)
     {
-      // ignore
+    case NodeType::Null:
+      return Node();
+    case NodeType::Boolean:
+      return scalar.bool_value;
+    case NodeType::Integer:
+      return scalar.int_value;
+    case NodeType::FloatingPoint:
+      return scalar.float_value;
+    default:
+      return str;
     }
   }
 
-  //
-  // floating point
-  //
+  // whether the next event provides a map key
+  bool isKey() const
+  {
+    return (!stack_.empty() && stack_.back().is_map && !stack_.back().has_key);
+  }
 
-  if (str == ".inf" || str == ".Inf" || str == ".INF")
+  void setKey(const String& key)
   {
-    return std::numeric_limits<Float>::infinity();
+    Frame& frame = stack_.back();
+    frame.key = key;
+    frame.has_key = true;
   }
 
-  if (str == "-.inf" || str == "-.Inf" || str == "-.INF")
+  void begin(bool is_map, const YAML::Mark& mark, YAML::anchor_t anchor)
   {
-    return -std::numeric_limits<Float>::infinity();
+    if (isKey())
+    {
+      raise("map keys must be scalars", mark);
+    }
+
+    Frame frame;
+    frame.mark = makeMark(mark);
+    frame.anchor = anchor;
+    frame.is_map = is_map;
+    frame.has_key = false;
+    stack_.push_back(std::move(frame));
   }
 
-  if (str == ".nan" || str == ".NaN" || str == ".NAN")
+  void end()
   {
-    return std::numeric_limits<Float>::quiet_NaN();
+    Frame& frame = stack_.back();
+    Node value;
+    if (frame.is_map)
+    {
+      value = Node(std::move(frame.map));
+    }
+    else
+    {
+      value = Node(std::move(frame.seq));
+    }
+    ParseMark mark = std::move(frame.mark);
+    YAML::anchor_t anchor = frame.anchor;
+    stack_.pop_back();
+    complete(std::move(value), std::move(mark), anchor);
   }
 
-  try
+  // registers the parse mark and anchor of the node, and adds it to its parent
+  void complete(Node&& value, const YAML::Mark& mark, YAML::anchor_t anchor)
   {
-    std::size_t pos;
-    Float val = std::stod(str, &pos);
-    if (pos == str.size())
+    complete(std::move(value), makeMark(mark), anchor);
+  }
+
+  void complete(Node&& value, ParseMark mark, YAML::anchor_t anchor)
+  {
+    parseinfo_.insert(std::make_pair(value.id(), std::move(mark)));
+    if (anchor != YAML::NullAnchor)
     {
-      return val;
+      anchors_[anchor] = value.share();
     }
+    add(std::move(value));
   }
-  catch (const std::exception& e)
+
+  // registers an anchored key, which aliases may refer to as a value
+  void completeKey(Node&& key, const YAML::Mark& mark, YAML::anchor_t anchor)
   {
-    // ignore
+    if (anchor != YAML::NullAnchor)
+    {
+      parseinfo_.insert(std::make_pair(key.id(), makeMark(mark)));
+      anchors_[anchor] = std::move(key);
+    }
   }
 
-  //
-  // String
-  //
+  void add(Node&& value)
+  {
+    if (stack_.empty())
+    {
+      root_ = std::move(value);
+      return;
+    }
 
-  return str;
+    Frame& frame = stack_.back();
+    if (frame.is_map)
+    {
+      frame.map.push_back(MapEntry(std::move(frame.key), std::move(value)));
+      frame.has_key = false;
+    }
+    else
+    {
+      frame.seq.push_back(std::move(value));
+    }
+  }
+
+  ParseMark makeMark(const YAML::Mark& mark) const
+  {
+    return ParseMark(filename_, line_offset_ + mark.line+1, mark.column+1);
+  }
+
+  [[noreturn]] void raise(const char* msg, const YAML::Mark& mark) const
+  {
+    throw ImportException(msg, filename_, line_offset_ + mark.line+1,
+                          mark.column+1);
+  }
+
+  StringPtr filename_;
+  ParseInfo& parseinfo_;
+  unsigned line_offset_;
+  std::vector<Frame> stack_;
+  std::unordered_map<YAML::anchor_t, Node> anchors_;
+  std::unordered_map<YAML::anchor_t, String> texts_; // of anchored scalars
+  detail::YamlScalarCache cache_;
+  Node root_;
+}; // class YamlImport::Builder
+
+//
+// YamlImport implementation
+//
+
+Node YamlImport::load(std::istream& strm)
+{
+  return load(strm, nullptr);
 }
 
-Node YamlImport::transformSequence(const YAML::Node& node)
+Node YamlImport::load(const String& str)
 {
-  Sequence seq;
-  seq.reserve(node.size());
-  for (auto iter = node.begin(); iter != node.end(); ++iter)
+  std::stringstream sstrm(str);
+  return load(sstrm);
+}
+
+Node YamlImport::loadFromFile(const String& filename)
+{
+  std::ifstream fstrm(filename.c_str());
+  return load(fstrm, std::make_shared<String>(filename));
+}
+
+Sequence YamlImport::loadAll(std::istream& strm)
+{
+  return loadAll(strm, nullptr);
+}
+
+Sequence YamlImport::loadAll(const String& str)
+{
+  std::stringstream sstrm(str);
+  return loadAll(sstrm);
+}
+
+Sequence YamlImport::loadAllFromFile(const String& filename)
+{
+  std::ifstream fstrm(filename.c_str());
+  return loadAll(fstrm, std::make_shared<String>(filename));
+}
+
+void YamlImport::forEachDocument(std::istream& strm,
+                                 const std::function<void(Node&)>& fcn)
+{
+  setStream(strm, nullptr);
+  YAML::Parser parser(strm);
+  Builder builder(filename_, parseinfo_);
+  while (true)
+  {
+    parseinfo_.clear();
+    if (!builder.parse(parser))
+    {
+      return;
+    }
+    Node document = builder.result();
+    fcn(document);
+  }
+}
+
+Node YamlImport::load(std::istream &strm, StringPtr filename)
+{
+  setStream(strm, std::move(filename));
+  YAML::Parser parser(strm);
+  Builder builder(filename_, parseinfo_);
+  builder.parse(parser);
+  return builder.result();
+}
+
+Sequence YamlImport::loadAll(std::istream& strm, StringPtr filename)
+{
+  setStream(strm, std::move(filename));
+  if (detail::resolveThreads(num_threads_) > 1)
+  {
+    return loadParallel(strm);
+  }
+  return parseAll(strm);
+}
+
+Sequence YamlImport::parseAll(std::istream& strm)
+{
+  Sequence documents;
+  YAML::Parser parser(strm);
+  Builder builder(filename_, parseinfo_);
+  while (builder.parse(parser))
+  {
+    documents.push_back(builder.result());
+  }
+  return documents;
+}
+
+Sequence YamlImport::loadParallel(std::istream& strm)
+{
+  String text((std::istreambuf_iterator<char>(strm)),
+              std::istreambuf_iterator<char>());
+  std::vector<DocumentRange> ranges;
+  if (!splitDocuments(text, ranges))
   {
-    seq.push_back(transform(*iter));
+    MemoryBuffer buffer(&text[0], &text[0] + text.size());
+    std::istream sequential(&buffer);
+    return parseAll(sequential);
+  }
+
+  // a range may contain several documents if they end with '...'
+  std::vector<Sequence> range_documents(ranges.size());
+  std::vector<ParseInfo> range_parseinfo(ranges.size());
+  detail::parallelFor(ranges.size(), num_threads_,
+                      [&](std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      const DocumentRange& range = ranges[i];
+      MemoryBuffer buffer(&text[range.begin], &text[range.end]);
+      std::istream range_strm(&buffer);
+      YAML::Parser parser(range_strm);
+      Builder builder(filename_, range_parseinfo[i], range.line);
+      while (builder.parse(parser))
+      {
+        range_documents[i].push_back(builder.result());
+      }
+    }
+  });
+
+  Sequence documents;
+  for (std::size_t i = 0; i < ranges.size(); ++i)
+  {
+    for (Node& document : range_documents[i])
+    {
+      documents.push_back(std::move(document));
+    }
+    parseinfo_.insert(range_parseinfo[i].begin(), range_parseinfo[i].end());
   }
-  return Node(std::move(seq));
+  return documents;
 }
 
-Node YamlImport::transformMap(const YAML::Node& node)
+void YamlImport::setStream(std::istream& strm, StringPtr filename)
 {
-  Map map;
-  map.reserve(node.size());
-  for (auto iter = node.begin(); iter != node.end(); ++iter)
+  // reset the parse info when the stream changes
+  if (strm_ != &strm)
   {
-    map.emplace_back(iter->first.Scalar(), transform(iter->second));
+    strm_ = &strm;
+    parseinfo_.clear();
   }
-  return Node(std::move(map));
+  filename_ = std::move(filename);
 }
 
 } // namespace cpds
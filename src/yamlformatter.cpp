@@ -0,0 +1,399 @@
+/*
+ * yamlformatter.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "yamlformatter.hpp"
+#include <cmath>
+#include <cstring>
+#include <strings.h>
+#include "numformat.hpp"
+#include "yamlscalar.hpp"
+
+namespace cpds {
+namespace detail {
+
+// enforce local linkage
+namespace {
+
+// indentation per nesting level
+constexpr unsigned k_yaml_indent = 2;
+
+inline bool isDigit(char c)
+{
+  return (c >= '0' && c <= '9');
+}
+
+inline bool isBlank(char c)
+{
+  return (c == ' ' || c == '\t');
+}
+
+inline bool equalsNoCase(const char* str, std::size_t length,
+                         const char* other)
+{
+  return (length == std::strlen(other) &&
+          strncasecmp(str, other, length) == 0);
+}
+
+// plain scalars that the import resolves to null, booleans or numbers
+bool isSpecialPlain(const char* str, std::size_t length)
+{
+  if (!isYamlPlainString(str, length))
+  {
+    return true;
+  }
+
+  // anything that starts like a number, which is more than the Core Schema
+  // requires but keeps the check simple
+  std::size_t sign = (str[0] == '+' || str[0] == '-') ? 1 : 0;
+  std::size_t pos = sign;
+  if (pos < length && str[pos] == '.')
+  {
+    pos++;
+  }
+  if (pos < length && isDigit(str[pos]))
+  {
+    return true;
+  }
+
+  // the words that strtod() accepts
+  const char* word = str + sign;
+  std::size_t word_length = length - sign;
+  return (equalsNoCase(word, word_length, "inf") ||
+          equalsNoCase(word, word_length, "infinity") ||
+          equalsNoCase(word, word_length, "nan"));
+}
+
+} // unnamed namespace
+
+bool isFlowSequence(const Node& node)
+{
+  const Sequence& seq = node.sequence();
+  if (seq.empty())
+  {
+    return false;
+  }
+  for (const Node& element : seq)
+  {
+    if (!element.isNumber())
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool needsYamlQuotes(const char* str, std::size_t length)
+{
+  if (length == 0 || isSpecialPlain(str, length))
+  {
+    return true;
+  }
+
+  // indicators at the start, see 7.3.3 of YAML 1.2
+  char first = str[0];
+  if (std::strchr(",[]{}#&*!|>'\"%@`", first) != nullptr || isBlank(first))
+  {
+    return true;
+  }
+  if ((first == '-' || first == '?' || first == ':') &&
+      (length == 1 || isBlank(str[1])))
+  {
+    return true;
+  }
+
+  // document markers at the start of a line
+  if (length >= 3 && (std::strncmp(str, "---", 3) == 0 ||
+                      std::strncmp(str, "...", 3) == 0))
+  {
+    return true;
+  }
+
+  // trailing blanks would be stripped, a trailing colon denotes a key
+  char last = str[length-1];
+  if (isBlank(last) || last == ':')
+  {
+    return true;
+  }
+
+  for (std::size_t i = 0; i < length; ++i)
+  {
+    unsigned char c = static_cast<unsigned char>(str[i]);
+    if (c < 0x20 || c == 0x7f)
+    {
+      return true; // includes tabs and line breaks
+    }
+    else if ((c == ':' && isBlank(str[i+1])) ||
+             (c == '#' && isBlank(str[i-1])))
+    {
+      return true; // mapping value or comment, i is within (0, length-1)
+    }
+  }
+  return false;
+}
+
+YamlFormatter::YamlFormatter(WriteBuffer& buffer)
+  : buffer_(buffer)
+{
+}
+
+void YamlFormatter::scalar(const Node& node)
+{
+  beginValue();
+  switch (node.type())
+  {
+  case NodeType::Null:
+    writeNull();
+    break;
+  case NodeType::Boolean:
+    writeBoolean(node.boolValue());
+    break;
+  case NodeType::Integer:
+    writeInteger(node.intValue());
+    break;
+  case NodeType::FloatingPoint:
+    writeFloat(node.floatValue());
+    break;
+  case NodeType::String:
+  {
+    const String& str = node.stringValue();
+    writeString(str.data(), str.size());
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void YamlFormatter::beginSequence(const Node& node)
+{
+  if (isFlowSequence(node))
+  {
+    openFlow();
+  }
+  else if (node.empty())
+  {
+    writeEmpty("[]");
+  }
+  else
+  {
+    openBlock();
+  }
+}
+
+void YamlFormatter::element(std::size_t index)
+{
+  if (context_ == Context::Flow)
+  {
+    if (index > 0)
+    {
+      buffer_.write(", ", 2);
+    }
+    return;
+  }
+
+  if (index > 0)
+  {
+    newline(depth_ - 1);
+  }
+  buffer_.write("- ", 2);
+  context_ = Context::Element;
+}
+
+void YamlFormatter::endSequence(const Node& node)
+{
+  if (context_ == Context::Flow)
+  {
+    closeFlow();
+  }
+  else if (!node.empty())
+  {
+    closeBlock();
+  }
+}
+
+void YamlFormatter::beginMap(const Node& node)
+{
+  if (node.empty())
+  {
+    writeEmpty("{}");
+  }
+  else
+  {
+    openBlock();
+  }
+}
+
+void YamlFormatter::key(const String& key, std::size_t index)
+{
+  if (index > 0)
+  {
+    newline(depth_ - 1);
+  }
+  writeString(key.data(), key.size());
+  buffer_.put(':');
+  context_ = Context::Key;
+}
+
+void YamlFormatter::endMap(const Node& node)
+{
+  if (!node.empty())
+  {
+    closeBlock();
+  }
+}
+
+void YamlFormatter::openBlock()
+{
+  // block collections below a key start on a new line, the first child of
+  // a collection within a sequence follows the dash
+  if (context_ == Context::Key)
+  {
+    newline(depth_);
+  }
+  depth_++;
+}
+
+void YamlFormatter::openFlow()
+{
+  beginValue();
+  buffer_.put('[');
+  context_ = Context::Flow;
+}
+
+void YamlFormatter::closeFlow()
+{
+  buffer_.put(']');
+  context_ = Context::Element; // the parent sets it for the next child
+}
+
+void YamlFormatter::writeEmpty(const char* text)
+{
+  beginValue();
+  buffer_.write(text, 2);
+}
+
+void YamlFormatter::writeBoolean(bool value)
+{
+  if (value)
+  {
+    buffer_.write("true", 4);
+  }
+  else
+  {
+    buffer_.write("false", 5);
+  }
+}
+
+void YamlFormatter::writeInteger(Int value)
+{
+  char* pos = buffer_.reserve(k_max_number_length);
+  buffer_.commit(formatInteger(pos, value) - pos);
+}
+
+void YamlFormatter::writeFloat(Float value)
+{
+  if (std::isnan(value))
+  {
+    buffer_.write(".nan", 4);
+  }
+  else if (std::isinf(value))
+  {
+    if (value < 0)
+    {
+      buffer_.write("-.inf", 5);
+    }
+    else
+    {
+      buffer_.write(".inf", 4);
+    }
+  }
+  else
+  {
+    // with a fractional part, such that it is read back as floating point
+    char* begin = buffer_.reserve(k_max_number_length + 2);
+    char* end = formatShortest(begin, value);
+    if (isIntegerText(begin, end))
+    {
+      *end++ = '.';
+      *end++ = '0';
+    }
+    buffer_.commit(end - begin);
+  }
+}
+
+void YamlFormatter::writeString(const char* str, std::size_t length)
+{
+  static const char k_hex[] = "0123456789abcdef";
+
+  if (!needsYamlQuotes(str, length))
+  {
+    buffer_.write(str, length);
+    return;
+  }
+
+  buffer_.put('"');
+  const char* run = str;
+  const char* end = str + length;
+  for (const char* pos = str; pos != end; ++pos)
+  {
+    unsigned char c = static_cast<unsigned char>(*pos);
+    if (c >= 0x20 && c != 0x7f && c != '"' && c != '\\')
+    {
+      continue;
+    }
+
+    buffer_.write(run, pos - run);
+    run = pos + 1;
+    switch (c)
+    {
+    case '"':
+      buffer_.write("\\\"", 2);
+      break;
+    case '\\':
+      buffer_.write("\\\\", 2);
+      break;
+    case '\n':
+      buffer_.write("\\n", 2);
+      break;
+    case '\t':
+      buffer_.write("\\t", 2);
+      break;
+    case '\r':
+      buffer_.write("\\r", 2);
+      break;
+    default:
+    {
+      char seq[4] = { '\\', 'x', k_hex[c >> 4], k_hex[c & 0xf] };
+      buffer_.write(seq, sizeof(seq));
+      break;
+    }
+    }
+  }
+  buffer_.write(run, end - run);
+  buffer_.put('"');
+}
+
+void YamlFormatter::beginValue()
+{
+  // map values are separated from the colon, elements follow the dash
+  if (context_ == Context::Key)
+  {
+    buffer_.put(' ');
+  }
+}
+
+void YamlFormatter::newline(unsigned level)
+{
+  buffer_.put('\n');
+  buffer_.fill(' ', level * k_yaml_indent);
+}
+
+} // namespace detail
+} // namespace cpds
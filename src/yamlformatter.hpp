@@ -0,0 +1,111 @@
+/*
+ * yamlformatter.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include "cpds/node.hpp"
+#include "writebuffer.hpp"
+
+namespace cpds {
+namespace detail {
+
+/**
+ * Writes YAML text into a WriteBuffer, without YAML::Emitter.
+ *
+ * Maps and sequences use block style with an indent of two, empty ones are
+ * written as {} and []. Sequences that contain only numbers use flow style
+ * on a single line, e.g. [1, 2.5]. Strings are written as plain scalars
+ * where this is unambiguous, and as double-quoted scalars otherwise.
+ *
+ * The formatter implements the visitor interface of walk(). It keeps no
+ * per-level state and does not allocate memory. Writers without a Node tree
+ * use the structure and building blocks directly, in the same order.
+ **/
+class YamlFormatter
+{
+public:
+  explicit YamlFormatter(WriteBuffer& buffer);
+
+  /**
+   * \name Visitor Interface
+   **/
+  //@{
+  void scalar(const Node& node);
+  void beginSequence(const Node& node);
+  void element(std::size_t index);
+  void endSequence(const Node& node);
+  void beginMap(const Node& node);
+  void key(const String& key, std::size_t index);
+  void endMap(const Node& node);
+  //@} // Visitor Interface
+
+  /**
+   * \name Structure
+   * A non-empty block collection is opened before its first child and closed
+   * after its last one, element() and key() precede each child. A flow
+   * sequence is opened, separated by element() and closed likewise.
+   **/
+  //@{
+  void openBlock();
+  void closeBlock() { depth_--; }
+  void openFlow();
+  void closeFlow();
+  void writeEmpty(const char* text); // "[]" or "{}"
+  //@} // Structure
+
+  /**
+   * \name Building Blocks
+   * A scalar is written with beginValue() and one of the write methods.
+   **/
+  //@{
+  void beginValue();
+  void writeNull() { buffer_.put('~'); }
+  void writeBoolean(bool value);
+  void writeInteger(Int value);
+  void writeFloat(Float value);
+  void writeString(const char* str, std::size_t length);
+  //@} // Building Blocks
+
+  /**
+   * Continues the output within the given number of open block containers.
+   * This is used to write the children of a container in separate chunks.
+   **/
+  void setDepth(unsigned depth) { depth_ = depth; }
+
+private:
+  // what the next value follows
+  enum class Context
+  {
+    Document,
+    Key,
+    Element,
+    Flow, // within a flow sequence
+  }; // enum class Context
+
+  void newline(unsigned level);
+
+  WriteBuffer& buffer_;
+  Context context_ = Context::Document;
+  unsigned depth_ = 0; // number of open non-empty containers
+}; // class YamlFormatter
+
+/**
+ * Returns whether the node is a sequence that is written in flow style.
+ **/
+bool isFlowSequence(const Node& node);
+
+/**
+ * Returns whether the string must be double-quoted, i.e. whether it would
+ * not be read back as the identical string from a plain scalar.
+ **/
+bool needsYamlQuotes(const char* str, std::size_t length);
+
+} // namespace detail
+} // namespace cpds
@@ -0,0 +1,291 @@
+/*
+ * yamlscalar.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "yamlscalar.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace cpds {
+namespace detail {
+
+// enforce local linkage
+namespace {
+
+inline bool isDigit(char c)
+{
+  return (c >= '0' && c <= '9');
+}
+
+// whether the scalar may resolve to a number
+inline bool isNumberStart(char c)
+{
+  return (isDigit(c) || c == '+' || c == '-' || c == '.');
+}
+
+// the Core Schema accepts lowercase, capitalized and uppercase words
+bool isWord(const char* str, std::size_t length,
+            const char* lower, const char* capital, const char* upper)
+{
+  if (length != std::strlen(lower))
+  {
+    return false;
+  }
+  return (std::memcmp(str, lower, length) == 0 ||
+          std::memcmp(str, capital, length) == 0 ||
+          std::memcmp(str, upper, length) == 0);
+}
+
+// value of the digit in base 8 or 16, or -1
+inline int digitValue(char c, unsigned base)
+{
+  if (c >= '0' && c <= '7')
+  {
+    return c - '0';
+  }
+  if (base == 16)
+  {
+    if (c >= '8' && c <= '9')
+    {
+      return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+      return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+      return c - 'A' + 10;
+    }
+  }
+  return -1;
+}
+
+// 0o[0-7]+ and 0x[0-9a-fA-F]+
+void resolveRadix(const char* str, std::size_t length, unsigned base,
+                  YamlScalar& result)
+{
+  constexpr uint64_t k_max = std::numeric_limits<Int>::max();
+  uint64_t value = 0;
+  for (std::size_t pos = 2; pos < length; ++pos)
+  {
+    int digit = digitValue(str[pos], base);
+    if (digit < 0 || value > (k_max - digit) / base)
+    {
+      return; // not a number, or out of range
+    }
+    value = value * base + digit;
+  }
+  result.type = NodeType::Integer;
+  result.int_value = static_cast<Int>(value);
+}
+
+// [-+]?[0-9]+ and [-+]?(\.[0-9]+|[0-9]+(\.[0-9]*)?)([eE][-+]?[0-9]+)?
+// floating point numbers are only converted if the text is null terminated
+void resolveDecimal(const char* s, std::size_t length, bool convert,
+                    YamlScalar& result)
+{
+  std::size_t pos = 0;
+  bool negative = false;
+  if (s[pos] == '+' || s[pos] == '-')
+  {
+    negative = (s[pos] == '-');
+    pos++;
+  }
+
+  // integer part
+  constexpr uint64_t k_max = std::numeric_limits<Int>::max();
+  const uint64_t limit = negative ? k_max + 1 : k_max;
+  uint64_t value = 0;
+  bool overflow = false;
+  std::size_t num_digits = 0;
+  for (; pos < length && isDigit(s[pos]); ++pos, ++num_digits)
+  {
+    uint64_t digit = s[pos] - '0';
+    if (value > (limit - digit) / 10)
+    {
+      overflow = true;
+    }
+    else
+    {
+      value = value * 10 + digit;
+    }
+  }
+
+  if (pos == length)
+  {
+    if (num_digits == 0)
+    {
+      return; // sign only
+    }
+    if (!overflow)
+    {
+      result.type = NodeType::Integer;
+      result.int_value = negative ? static_cast<Int>(0 - value)
+                                  : static_cast<Int>(value);
+      return;
+    }
+    // too large for Int, but still a valid float
+  }
+  else
+  {
+    // fraction
+    if (s[pos] == '.')
+    {
+      pos++;
+      std::size_t num_fraction = 0;
+      for (; pos < length && isDigit(s[pos]); ++pos, ++num_fraction) {}
+      if (num_digits + num_fraction == 0)
+      {
+        return;
+      }
+      num_digits += num_fraction;
+    }
+    if (num_digits == 0)
+    {
+      return;
+    }
+
+    // exponent
+    if (pos < length && (s[pos] == 'e' || s[pos] == 'E'))
+    {
+      pos++;
+      if (pos < length && (s[pos] == '+' || s[pos] == '-'))
+      {
+        pos++;
+      }
+      std::size_t num_exponent = 0;
+      for (; pos < length && isDigit(s[pos]); ++pos, ++num_exponent) {}
+      if (num_exponent == 0)
+      {
+        return;
+      }
+    }
+    if (pos != length)
+    {
+      return;
+    }
+  }
+
+  // the text is validated, strtod() only performs the conversion
+  result.type = NodeType::FloatingPoint;
+  if (convert)
+  {
+    result.float_value = std::strtod(s, nullptr);
+  }
+}
+
+YamlScalar resolve(const char* s, std::size_t length, bool convert)
+{
+  YamlScalar result;
+
+  if (length == 0 || (length == 1 && s[0] == '~') ||
+      isWord(s, length, "null", "Null", "NULL"))
+  {
+    result.type = NodeType::Null;
+    return result;
+  }
+
+  switch (s[0])
+  {
+  case 't':
+  case 'T':
+    if (isWord(s, length, "true", "True", "TRUE"))
+    {
+      result.type = NodeType::Boolean;
+      result.bool_value = true;
+    }
+    return result;
+  case 'f':
+  case 'F':
+    if (isWord(s, length, "false", "False", "FALSE"))
+    {
+      result.type = NodeType::Boolean;
+      result.bool_value = false;
+    }
+    return result;
+  default:
+    break;
+  }
+
+  if (!isNumberStart(s[0]))
+  {
+    return result;
+  }
+
+  // special floating point values
+  std::size_t sign = (s[0] == '+' || s[0] == '-') ? 1 : 0;
+  if (isWord(s + sign, length - sign, ".inf", ".Inf", ".INF"))
+  {
+    result.type = NodeType::FloatingPoint;
+    result.float_value = (s[0] == '-') ? -std::numeric_limits<Float>::infinity()
+                                       : std::numeric_limits<Float>::infinity();
+    return result;
+  }
+  if (isWord(s, length, ".nan", ".NaN", ".NAN"))
+  {
+    result.type = NodeType::FloatingPoint;
+    result.float_value = std::numeric_limits<Float>::quiet_NaN();
+    return result;
+  }
+
+  if (length > 2 && s[0] == '0' && (s[1] == 'o' || s[1] == 'x'))
+  {
+    resolveRadix(s, length, (s[1] == 'o') ? 8 : 16, result);
+    return result;
+  }
+
+  resolveDecimal(s, length, convert, result);
+  return result;
+}
+
+} // unnamed namespace
+
+YamlScalar resolveYamlScalar(const String& str)
+{
+  return resolve(str.c_str(), str.size(), true);
+}
+
+bool isYamlPlainString(const char* str, std::size_t length)
+{
+  return (resolve(str, length, false).type == NodeType::String);
+}
+
+//
+// YamlScalarCache implementation
+//
+
+YamlScalar YamlScalarCache::resolve(const String& str)
+{
+  if (str.empty() || str.size() > k_max_length || !isNumberStart(str[0]))
+  {
+    return resolveYamlScalar(str);
+  }
+
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (char c : str)
+  {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+
+  Entry& entry = entries_[hash & (k_num_entries - 1)];
+  if (!entry.used || entry.text != str)
+  {
+    entry.used = true;
+    entry.text.assign(str); // reuses the capacity of the previous text
+    entry.scalar = resolveYamlScalar(str);
+  }
+  return entry.scalar;
+}
+
+} // namespace detail
+} // namespace cpds
@@ -0,0 +1,72 @@
+/*
+ * yamlscalar.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include "cpds/typedefs.hpp"
+
+namespace cpds {
+namespace detail {
+
+/**
+ * Value of a resolved plain scalar. Only the member that corresponds to the
+ * type is valid, String scalars keep their text.
+ **/
+struct YamlScalar
+{
+  NodeType type = NodeType::String;
+  bool bool_value = false;
+  Int int_value = 0;
+  Float float_value = 0.0;
+}; // struct YamlScalar
+
+/**
+ * Resolves a plain scalar following the Core Schema (10.3.2 of YAML 1.2).
+ *
+ * The text is examined in a single pass; no exceptions are thrown and no
+ * memory is allocated. Octal and hexadecimal integers that exceed the range
+ * of Int stay strings, decimal ones become floating point numbers.
+ **/
+YamlScalar resolveYamlScalar(const String& str);
+
+/**
+ * Returns whether resolveYamlScalar() keeps the text as String, i.e. whether
+ * it can be written as plain scalar without changing its type. The text
+ * does not need to be null terminated.
+ **/
+bool isYamlPlainString(const char* str, std::size_t length);
+
+/**
+ * Remembers the resolution of recently seen number-like scalars, which
+ * repeat frequently in calibration data (e.g. 0.0 and 1.0 in matrices).
+ * Other scalars are resolved directly, since this is cheaper than a lookup.
+ **/
+class YamlScalarCache
+{
+public:
+  YamlScalar resolve(const String& str);
+
+private:
+  static constexpr std::size_t k_num_entries = 64; // power of two
+  static constexpr std::size_t k_max_length = 24; // longer ones are not cached
+
+  struct Entry
+  {
+    bool used = false;
+    String text;
+    YamlScalar scalar;
+  }; // struct Entry
+
+  Entry entries_[k_num_entries];
+}; // class YamlScalarCache
+
+} // namespace detail
+} // namespace cpds
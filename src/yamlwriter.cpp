@@ -0,0 +1,164 @@
+/*
+ * yamlwriter.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "yamlwriter.hpp"
+
+namespace cpds {
+namespace detail {
+
+YamlWriter::YamlWriter(WriteBuffer& buffer)
+  : formatter_(buffer)
+{
+}
+
+void YamlWriter::beginMap()
+{
+  beginChild();
+  stack_.push_back(Frame{true, State::Empty, 0});
+}
+
+void YamlWriter::endMap()
+{
+  if (stack_.back().state == State::Empty)
+  {
+    formatter_.writeEmpty("{}");
+  }
+  else
+  {
+    formatter_.closeBlock();
+  }
+  stack_.pop_back();
+}
+
+void YamlWriter::beginSequence()
+{
+  beginChild();
+  stack_.push_back(Frame{false, State::Empty, 0});
+}
+
+void YamlWriter::endSequence()
+{
+  switch (stack_.back().state)
+  {
+  case State::Empty:
+    formatter_.writeEmpty("[]");
+    break;
+  case State::Numbers:
+    formatter_.openFlow();
+    for (std::size_t i = 0; i < numbers_.size(); ++i)
+    {
+      formatter_.element(i);
+      writeNumber(numbers_[i]);
+    }
+    formatter_.closeFlow();
+    numbers_.clear();
+    break;
+  case State::Block:
+    formatter_.closeBlock();
+    break;
+  }
+  stack_.pop_back();
+}
+
+void YamlWriter::key(const String& key)
+{
+  Frame& frame = stack_.back();
+  if (frame.state == State::Empty)
+  {
+    formatter_.openBlock();
+    frame.state = State::Block;
+  }
+  formatter_.key(key, frame.count++);
+}
+
+void YamlWriter::null()
+{
+  beginChild();
+  formatter_.beginValue();
+  formatter_.writeNull();
+}
+
+void YamlWriter::value(bool value)
+{
+  beginChild();
+  formatter_.beginValue();
+  formatter_.writeBoolean(value);
+}
+
+void YamlWriter::value(Int value)
+{
+  addNumber(Number{false, value, 0.0});
+}
+
+void YamlWriter::value(Float value)
+{
+  addNumber(Number{true, 0, value});
+}
+
+void YamlWriter::value(const String& value)
+{
+  beginChild();
+  formatter_.beginValue();
+  formatter_.writeString(value.data(), value.size());
+}
+
+void YamlWriter::beginChild()
+{
+  // map values follow their key, only sequences have to open their block
+  if (stack_.empty() || stack_.back().is_map)
+  {
+    return;
+  }
+
+  Frame& frame = stack_.back();
+  if (frame.state != State::Block)
+  {
+    // the sequence is not a flow sequence after all
+    formatter_.openBlock();
+    frame.state = State::Block;
+    for (const Number& number : numbers_)
+    {
+      formatter_.element(frame.count++);
+      writeNumber(number);
+    }
+    numbers_.clear();
+  }
+  formatter_.element(frame.count++);
+}
+
+void YamlWriter::addNumber(const Number& number)
+{
+  if (!stack_.empty() && !stack_.back().is_map &&
+      stack_.back().state != State::Block)
+  {
+    stack_.back().state = State::Numbers;
+    numbers_.push_back(number);
+    return;
+  }
+
+  beginChild();
+  writeNumber(number);
+}
+
+void YamlWriter::writeNumber(const Number& number)
+{
+  formatter_.beginValue();
+  if (number.is_float)
+  {
+    formatter_.writeFloat(number.float_value);
+  }
+  else
+  {
+    formatter_.writeInteger(number.int_value);
+  }
+}
+
+} // namespace detail
+} // namespace cpds
@@ -0,0 +1,76 @@
+/*
+ * yamlwriter.hpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <vector>
+#include "cpds/json.hpp"
+#include "yamlformatter.hpp"
+
+namespace cpds {
+namespace detail {
+
+/**
+ * Writes the content of a JSON document as YAML while it is being parsed.
+ *
+ * The text is identical to the one YamlExport writes for the same tree. As
+ * the style of a sequence depends on all its elements, leading numbers are
+ * kept until the first other element or the end of the sequence.
+ **/
+class YamlWriter : public JsonHandler
+{
+public:
+  explicit YamlWriter(WriteBuffer& buffer);
+
+  void beginMap() override;
+  void endMap() override;
+  void beginSequence() override;
+  void endSequence() override;
+  void key(const String& key) override;
+
+  void null() override;
+  void value(bool value) override;
+  void value(Int value) override;
+  void value(Float value) override;
+  void value(const String& value) override;
+
+private:
+  enum class State
+  {
+    Empty,
+    Numbers, // sequence with numbers only so far
+    Block,
+  }; // enum class State
+
+  struct Frame
+  {
+    bool is_map;
+    State state;
+    std::size_t count;
+  }; // struct Frame
+
+  struct Number
+  {
+    bool is_float;
+    Int int_value;
+    Float float_value;
+  }; // struct Number
+
+  void beginChild(); // before a child other than a pending number
+  void addNumber(const Number& number);
+  void writeNumber(const Number& number);
+
+  YamlFormatter formatter_;
+  std::vector<Frame> stack_;
+  std::vector<Number> numbers_; // of the innermost sequence
+}; // class YamlWriter
+
+} // namespace detail
+} // namespace cpds
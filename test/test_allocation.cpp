@@ -0,0 +1,149 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <gtest/gtest.h>
+#include "cpds/node.hpp"
+#include "cpds/json.hpp"
+#include "cpds/yaml.hpp"
+
+using namespace cpds;
+
+// enforce local linkage
+namespace {
+
+// number of calls of the global operator new, replaced below
+std::atomic<std::size_t> g_num_allocations(0);
+
+} // unnamed namespace
+
+TEST(Allocation, JsonDumpTo)
+{
+  Node node = Map({{"a", Sequence({1, -2.5, 1e300, "x\ny", Map()})},
+                   {"b", Map({{"c", true}, {"d", Node()}})}});
+  Map map;
+  for (int i = 0; i < 1000; ++i)
+  {
+    map.emplace_back("key" + std::to_string(i), i * 0.5);
+  }
+  Node large = std::move(map);
+  std::vector<char> buffer(64 * 1024);
+
+  for (unsigned indent : {0u, 2u})
+  {
+    for (unsigned precision : {0u, 17u, 222u})
+    {
+      JsonExport json_export;
+      json_export.setIndent(indent);
+      json_export.setPrecision(precision);
+      std::size_t length = json_export.measure(large);
+      ASSERT_LE(length, buffer.size());
+
+      // also when the output exceeds the capacity
+      std::size_t before = g_num_allocations;
+      std::size_t small = json_export.dumpTo(buffer.data(), 100, node);
+      std::size_t complete = json_export.dumpTo(buffer.data(), length, large);
+      std::size_t truncated = json_export.dumpTo(buffer.data(), 100, large);
+      std::size_t num_allocations = g_num_allocations - before;
+
+      EXPECT_EQ(0u, num_allocations) << "precision " << precision;
+      EXPECT_EQ(json_export.measure(node), small);
+      EXPECT_EQ(length, complete);
+      EXPECT_EQ(length, truncated);
+    }
+  }
+}
+
+TEST(Allocation, YamlDumpTo)
+{
+  Node node = Map({{"a", Sequence({1, -2.5, 1e300, "x\ny", Map()})},
+                   {"b", Map({{"c", true}, {"d", Node()}})},
+                   {"c", Sequence({Sequence({1, 2}), "-.inf", ""})}});
+  Map map;
+  for (int i = 0; i < 1000; ++i)
+  {
+    map.emplace_back("key" + std::to_string(i),
+                     Sequence({i * 0.5, String(i % 300, 'x')}));
+  }
+  Node large = std::move(map);
+  Node text("text");
+  std::vector<char> buffer(512 * 1024);
+
+  YamlExport yaml_export;
+  std::size_t length = yaml_export.dump(large).size();
+  ASSERT_LE(length, buffer.size());
+
+  // also when the output exceeds the capacity, and for scalars
+  std::size_t before = g_num_allocations;
+  std::size_t small = yaml_export.dumpTo(buffer.data(), 100, node);
+  std::size_t complete = yaml_export.dumpTo(buffer.data(), length, large);
+  std::size_t truncated = yaml_export.dumpTo(buffer.data(), 100, large);
+  std::size_t scalar = yaml_export.dumpTo(buffer.data(), 2, text);
+  std::size_t num_allocations = g_num_allocations - before;
+
+  EXPECT_EQ(0u, num_allocations);
+  EXPECT_EQ(yaml_export.dump(node).size(), small);
+  EXPECT_EQ(length, complete);
+  EXPECT_EQ(length, truncated);
+  EXPECT_EQ(4u, scalar);
+}
+
+// the replacements forward to malloc() and free(), all forms are replaced so
+// that none of them is paired with the allocator of a sanitizer
+void* operator new(std::size_t size)
+{
+  ++g_num_allocations;
+  void* ptr = std::malloc(size > 0 ? size : 1);
+  if (ptr == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  ++g_num_allocations;
+  return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+  return operator new(size, tag);
+}
+
+// not inlined, GCC would report the free() of new expressions otherwise
+__attribute__((noinline)) void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+  std::free(ptr);
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include "cpds/node.hpp"
+#include "cpds/frozen.hpp"
+#include "cpds/exception.hpp"
+
+using namespace cpds;
+
+// enforce local linkage
+namespace {
+
+Node buildTestNode()
+{
+  Node node(Map({ { "a", Node() },
+                  { "b", true },
+                  { "c", 25 },
+                  { "d", 99.5 },
+                  { "e", "some str" },
+                  { "f", Sequence({false, 3.141592653589793, 6, ""}) },
+                  { "g", Map({ {"aa", 5}, {"bb", Sequence()} }) }
+                }));
+  return node;
+}
+
+} // unnamed namespace
+
+TEST(FrozenNode, DataAccess)
+{
+  Node node = buildTestNode();
+  Document doc(node);
+  FrozenNode root = doc.root();
+
+  EXPECT_TRUE(root.isMap());
+  EXPECT_EQ(7, root.size());
+  EXPECT_EQ(node.id(), root.id());
+  EXPECT_TRUE(root["a"].isNull());
+  EXPECT_TRUE(root["b"].boolValue());
+  EXPECT_EQ(25, root["c"].intValue());
+  EXPECT_DOUBLE_EQ(25.0, root["c"].floatValue());
+  EXPECT_DOUBLE_EQ(99.5, root.at("d").floatValue());
+  EXPECT_EQ("some str", root.at("e").stringValue());
+  EXPECT_STREQ("some str", root.at("e").c_str());
+  EXPECT_EQ(4, root["f"].size());
+  EXPECT_FALSE(root["f"][0].boolValue());
+  EXPECT_DOUBLE_EQ(3.141592653589793, root["f"][1].floatValue());
+  EXPECT_EQ(6, root["f"][2].intValue());
+  EXPECT_EQ("", root["f"][3].stringValue());
+  EXPECT_EQ(5, root["g"]["aa"].intValue());
+  EXPECT_TRUE(root["g"]["bb"].isSequence());
+  EXPECT_TRUE(root["g"]["bb"].empty());
+  EXPECT_EQ(node["g"]["aa"].id(), root["g"]["aa"].id());
+
+  EXPECT_TRUE(root.find("c") != root.end());
+  EXPECT_TRUE(root.find("cc") == root.end());
+  EXPECT_THROW(root.at("cc"), KeyException);
+  EXPECT_THROW(root["f"][4], KeyException);
+  EXPECT_THROW(root["f"]["a"], TypeException);
+  EXPECT_THROW(root[0], TypeException);
+  EXPECT_THROW(root["c"].boolValue(), TypeException);
+  EXPECT_THROW(root["b"].stringValue(), TypeException);
+  EXPECT_THROW(root["e"].sequence(), TypeException);
+}
+
+TEST(FrozenNode, Iteration)
+{
+  Node node = buildTestNode();
+  Document doc(node);
+  FrozenNode root = doc.root();
+
+  std::size_t idx = 0;
+  for (FrozenNode child : root["f"].sequence())
+  {
+    EXPECT_EQ(node["f"][idx].id(), child.id());
+    idx++;
+  }
+  EXPECT_EQ(4, idx);
+
+  const Map& map = static_cast<const Node&>(node).map();
+  idx = 0;
+  for (auto iter = root.map().begin(); iter != root.end(); ++iter)
+  {
+    EXPECT_EQ(map[idx].first, iter.key());
+    EXPECT_EQ(map[idx].second.type(), (*iter).type());
+    idx++;
+  }
+  EXPECT_EQ(map.size(), idx);
+}
+
+TEST(FrozenNode, Thaw)
+{
+  Node node = buildTestNode();
+  Document doc(node);
+
+  Node thawed = doc.root().thaw();
+  EXPECT_EQ(node, thawed);
+  EXPECT_EQ(node.id(), thawed.id());
+  EXPECT_EQ(node["f"][1].id(), thawed["f"][1].id());
+
+  // keys and strings with null characters are kept in full
+  String key("a\0b", 3);
+  Node nul = Map({ {key, String("x\0y", 3)}, {"a", 1} });
+  Document nul_doc(nul);
+  EXPECT_EQ(nul, nul_doc.root().thaw());
+  FrozenNode::const_iterator iter = nul_doc.root().find(key);
+  ASSERT_TRUE(iter != nul_doc.root().end());
+  EXPECT_EQ(key, String(iter.key(), iter.keyLength()));
+
+  Document scalar_doc(Node("scalar"));
+  EXPECT_EQ("scalar", scalar_doc.root().stringValue());
+  EXPECT_EQ(Node("scalar"), scalar_doc.root().thaw());
+}
+
+TEST(FrozenNode, DeepNesting)
+{
+  // deep enough to overflow a recursion
+  const int depth = 200000;
+  Node node = Sequence();
+  Node* cur = &node;
+  for (int i = 0; i < depth; ++i)
+  {
+    if (cur->isSequence())
+    {
+      cur->sequence().push_back(Map());
+      cur = &cur->sequence().back();
+    }
+    else
+    {
+      cur = &((*cur)["k"] = Sequence());
+    }
+  }
+  cur->sequence().push_back(5);
+
+  Document doc(node);
+  EXPECT_EQ(node, doc.root().thaw());
+}
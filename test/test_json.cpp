@@ -1,4 +1,13 @@
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
 #include <gtest/gtest.h>
 #include "cpds/node.hpp"
 #include "cpds/json.hpp"
@@ -31,8 +40,8 @@ TEST(JSON, DataExport)
   std::string cmp;
   exp = json_export.dump(buildTestNode());
   cmp = "{\"a\":null,\"b\":true,\"c\":25,\"d\":99.0,\"e\":\"str with ä and"
-        " \\/ } \\\" \\\\ special\\n \\u0001 chars\",\"f\":[false,3.14159,6],"
-        "\"g\":{\"aa\":5,\"bb\":1.79769e+308}}";
+        " \\/ } \\\" \\\\ special\\n \\u0001 chars\",\"f\":[false,3.141592653589793,"
+        "6],\"g\":{\"aa\":5,\"bb\":1.7976931348623157e+308}}";
   EXPECT_EQ(cmp, exp);
 
   json_export.setPrecision(9);
@@ -141,3 +150,513 @@ TEST(JSON, FileImport)
   EXPECT_EQ(4, mk.line());
   EXPECT_EQ(5, mk.position());
 }
+
+TEST(JSON, DeepNesting)
+{
+  const int depth = 100000;
+  String str = "{\"a\":";
+  str += String(depth, '[') + "{\"b\":null}" + String(depth, ']');
+  str += "}";
+
+  JsonImport json_import;
+  Node node = json_import.load(str);
+  const Node* cur = &node.at("a");
+  for (int i = 0; i < depth; ++i)
+  {
+    ASSERT_TRUE(cur->isSequence());
+    cur = &(*cur)[0];
+  }
+  EXPECT_TRUE(cur->at("b").isNull());
+
+  JsonExport json_export;
+  EXPECT_EQ(str, json_export.dump(node));
+
+  EXPECT_THROW(json_import.load(str.substr(0, str.size()-2)), ImportException);
+}
+
+TEST(JSON, LargeExport)
+{
+  // exceeds the block size of the output buffer
+  Map map;
+  for (int i = 0; i < 10000; ++i)
+  {
+    map.emplace_back("key" + std::to_string(i),
+                     Sequence({ i, "a \"quoted\"\tvalue \x1f", Map() }));
+  }
+  Node node(std::move(map));
+
+  JsonExport json_export;
+  json_export.setIndent(4);
+  std::stringstream sstrm;
+  json_export.dump(sstrm, node);
+  String str = json_export.dump(node);
+  EXPECT_EQ(sstrm.str(), str);
+  EXPECT_NE(String::npos, str.find("\"a \\\"quoted\\\"\\tvalue \\u001f\""));
+  EXPECT_NE(String::npos, str.find("{\n            \n        }"));
+
+  JsonImport json_import;
+  EXPECT_EQ(node, json_import.load(str));
+}
+
+TEST(JSON, Measure)
+{
+  Node node = Map({{"a", Sequence({1, -2.5, "x\ny", Map()})},
+                   {"b", Map({{"c", true}, {"d", Node()}})},
+                   {"e", Sequence()}});
+
+  JsonExport json_export;
+  EXPECT_EQ(json_export.dump(node).size(), json_export.measure(node));
+  json_export.setIndent(3);
+  EXPECT_EQ(json_export.dump(node).size(), json_export.measure(node));
+  json_export.setPrecision(4);
+  EXPECT_EQ(json_export.dump(node).size(), json_export.measure(node));
+
+  // exceeds the scratch block of the counter
+  Map map;
+  for (int i = 0; i < 1000; ++i)
+  {
+    map.emplace_back("key" + std::to_string(i), String(i, '"'));
+  }
+  node = std::move(map);
+  EXPECT_EQ(json_export.dump(node).size(), json_export.measure(node));
+
+  EXPECT_THROW(json_export.measure(Node(Sequence())), TypeException);
+}
+
+TEST(JSON, ParallelExport)
+{
+  Map map;
+  for (int i = 0; i < 1000; ++i)
+  {
+    map.emplace_back("key" + std::to_string(i),
+                     Map({{"a", Sequence({i, i * 0.25, "x\ty"})},
+                          {"b", Map()}}));
+  }
+  Node node(std::move(map));
+
+  for (unsigned indent : {0u, 2u})
+  {
+    JsonExport serial;
+    serial.setIndent(indent);
+    String expected = serial.dump(node);
+
+    for (unsigned num_threads : {0u, 3u, 64u})
+    {
+      JsonExport parallel;
+      parallel.setIndent(indent);
+      parallel.setThreads(num_threads);
+      EXPECT_EQ(expected, parallel.dump(node));
+      EXPECT_EQ(expected.size(), parallel.measure(node));
+
+      std::stringstream sstrm;
+      parallel.dump(sstrm, node);
+      EXPECT_EQ(expected, sstrm.str());
+    }
+  }
+}
+
+TEST(JSON, CachedExport)
+{
+  Map map;
+  for (int i = 0; i < 100; ++i)
+  {
+    map.emplace_back("key" + std::to_string(i),
+                     Map({{"a", Sequence({i, Map(), Sequence({i * 0.5})})},
+                          {"b", "text"}}));
+  }
+  Node node(std::move(map));
+
+  JsonExport cached;
+  cached.setCaching(true);
+  JsonExport plain;
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+
+  // scalar modifications
+  node["key5"]["a"][2][0] = "changed";
+  node["key7"]["b"] = false;
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+
+  // structural modifications
+  node["key9"]["a"].sequence().push_back(Sequence({1, 2}));
+  node.erase("key3");
+  node["new"] = Map({{"x", 1}});
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+
+  // subtrees that move to another depth or position
+  Node subtree = std::move(node["key10"]["a"]);
+  node["key11"]["a"][1]["moved"] = std::move(subtree);
+  std::swap(node["key12"], node["key13"]);
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+
+  // modifications through lookups, and through earlier references, which
+  // require touch()
+  node.at("key41").at("b") = "via at";
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+  node.at("key41").at("a")[2] = Sequence({0.25});
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+  node.find("key42")->second.at("a")[0] = -1;
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+  Node& key40 = node["key40"]["a"];
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+  key40.sequence()[0] = 100; // renews the revision itself
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+  Sequence& seq = key40.sequence();
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+  seq[0] = 101;
+  seq.push_back("late");
+  key40.touch();
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+  key40 = Map({{"replaced", true}});
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+
+  // changed settings
+  cached.setIndent(3);
+  plain.setIndent(3);
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+  node["key20"]["a"][0] = 1.25;
+  std::stringstream sstrm;
+  cached.dump(sstrm, node);
+  EXPECT_EQ(plain.dump(node), sstrm.str());
+
+  // a different tree
+  Node other = Map({{"a", Sequence({Map()})}});
+  EXPECT_EQ(plain.dump(other), cached.dump(other));
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+
+  // shared subtrees at different depths
+  Node shared = Map({{"s", Sequence({1, 2})}});
+  node["key30"] = shared.share();
+  node["key31"]["a"][1]["shared"] = shared.share();
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+  EXPECT_EQ(plain.dump(node), cached.dump(node));
+}
+
+TEST(JSON, CachedExportCost)
+{
+  // a few modifications between exports of a large tree
+  Map map;
+  for (int i = 0; i < 200; ++i)
+  {
+    Sequence seq;
+    for (int j = 0; j < 200; ++j)
+    {
+      seq.push_back(i * 0.1 + j * 0.001);
+    }
+    map.emplace_back("key" + std::to_string(i),
+                     Map({{"values", std::move(seq)}, {"name", "text"}}));
+  }
+  Node node(std::move(map));
+
+  JsonExport cached;
+  cached.setCaching(true);
+  JsonExport plain;
+  cached.dump(node);
+
+  // the fastest of several runs, to be robust against scheduling
+  using Clock = std::chrono::steady_clock;
+  Clock::duration cached_time = Clock::duration::max();
+  Clock::duration plain_time = Clock::duration::max();
+  for (int run = 0; run < 5; ++run)
+  {
+    node["key" + std::to_string(run * 7)]["values"][3] = run * 0.5;
+
+    Clock::time_point start = Clock::now();
+    String cached_text = cached.dump(node);
+    cached_time = std::min(cached_time, Clock::now() - start);
+
+    start = Clock::now();
+    String plain_text = plain.dump(node);
+    plain_time = std::min(plain_time, Clock::now() - start);
+    ASSERT_EQ(plain_text, cached_text);
+  }
+  EXPECT_LT(cached_time * 2, plain_time);
+}
+
+TEST(JSON, DumpTo)
+{
+  Node node = Map({{"a", Sequence({1, -2.5, "x\ny", Map()})},
+                   {"b", Map({{"c", true}, {"d", Node()}})}});
+
+  for (unsigned indent : {0u, 2u})
+  {
+    JsonExport json_export;
+    json_export.setIndent(indent);
+    String expected = json_export.dump(node);
+
+    char buffer[256];
+    std::size_t length = json_export.dumpTo(buffer, sizeof(buffer), node);
+    EXPECT_EQ(expected, String(buffer, length));
+
+    // truncation at every position
+    for (std::size_t capacity = 0; capacity < expected.size(); ++capacity)
+    {
+      std::memset(buffer, '#', sizeof(buffer));
+      EXPECT_EQ(expected.size(), json_export.dumpTo(buffer, capacity, node));
+      EXPECT_EQ(expected.substr(0, capacity), String(buffer, capacity));
+      EXPECT_EQ('#', buffer[capacity]);
+    }
+  }
+
+  // output beyond the scratch block of the buffer
+  Map map;
+  for (int i = 0; i < 1000; ++i)
+  {
+    map.emplace_back("key" + std::to_string(i), i * 0.5);
+  }
+  node = std::move(map);
+  JsonExport json_export;
+  String expected = json_export.dump(node);
+  std::vector<char> buffer(expected.size());
+  EXPECT_EQ(expected.size(),
+            json_export.dumpTo(buffer.data(), buffer.size() / 3, node));
+  EXPECT_EQ(expected.substr(0, buffer.size() / 3),
+            String(buffer.data(), buffer.size() / 3));
+
+  Node deep = Sequence();
+  for (int i = 0; i < 300; ++i)
+  {
+    deep = Map({{"k", std::move(deep)}});
+  }
+  EXPECT_EQ(0u, json_export.dumpTo(buffer.data(), buffer.size(), deep));
+
+  // numbers that exceed the scratch block
+  json_export.setPrecision(400);
+  node = Map({{"a", Sequence({0.1, 1e300, 2.5})}});
+  expected = json_export.dump(node);
+  buffer.assign(expected.size(), '#');
+  for (std::size_t capacity : {std::size_t(0), std::size_t(10),
+                               expected.size() / 2, expected.size()})
+  {
+    EXPECT_EQ(expected.size(),
+              json_export.dumpTo(buffer.data(), capacity, node));
+    EXPECT_EQ(expected.substr(0, capacity), String(buffer.data(), capacity));
+  }
+  json_export.setPrecision(0);
+  EXPECT_THROW(json_export.dumpTo(buffer.data(), buffer.size(), Node(1)),
+               TypeException);
+}
+
+TEST(JSON, FileExport)
+{
+  Map map;
+  for (int i = 0; i < 1000; ++i)
+  {
+    map.emplace_back("key" + std::to_string(i), Sequence({i, "value"}));
+  }
+  Node node(std::move(map));
+  JsonExport json_export;
+  json_export.setIndent(2);
+  String expected = json_export.dump(node);
+
+  // file descriptor, with parallel chunks
+  std::FILE* file = std::tmpfile();
+  ASSERT_NE(nullptr, file);
+  json_export.setThreads(4);
+  json_export.dumpToFd(fileno(file), node);
+  std::rewind(file);
+  String content;
+  char buffer[4096];
+  std::size_t length;
+  while ((length = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+  {
+    content.append(buffer, length);
+  }
+  std::fclose(file);
+  EXPECT_EQ(expected, content);
+
+  // plain and atomic replacement, which keeps the permissions
+  const String dir = "/tmp/cpds_file_export";
+  const String path = dir + "/out.json";
+  ::mkdir(dir.c_str(), 0755);
+  std::remove(path.c_str());
+  json_export.dumpToFile(path, Node(Map({{"a", 1}})));
+  ::chmod(path.c_str(), 0640);
+  json_export.dumpToFile(path, node, true);
+
+  JsonImport json_import;
+  EXPECT_EQ(node, json_import.loadFromFile(path));
+  struct stat info;
+  ASSERT_EQ(0, ::stat(path.c_str(), &info));
+  EXPECT_EQ(0640u, info.st_mode & 0777);
+
+  // no temporary files remain, also not after a failure
+  EXPECT_THROW(json_export.dumpToFile(dir + "/missing/out.json", node, true),
+               Exception);
+  std::size_t num_entries = 0;
+  DIR* handle = ::opendir(dir.c_str());
+  ASSERT_NE(nullptr, handle);
+  while (dirent* entry = ::readdir(handle))
+  {
+    if (entry->d_name[0] != '.')
+    {
+      num_entries++;
+    }
+  }
+  ::closedir(handle);
+  EXPECT_EQ(1u, num_entries);
+}
+
+TEST(JSON, FloatRoundTrip)
+{
+  Sequence seq = { 0.0, -0.0, 0.1, 1e-5, 1e17, 99.2, -1.0/3.0,
+                   2.2250738585072014e-308, 123456789012345678.0 };
+  double value = 1.0;
+  for (int i = 0; i < 1000; ++i)
+  {
+    value = value * -1.0001 + 1.0 / (i + 3);
+    seq.push_back(value * std::pow(10.0, (i % 40) - 20));
+  }
+  Node node(Map({ { "values", seq } }));
+
+  JsonExport json_export;
+  JsonImport json_import;
+  String str = json_export.dump(node);
+  Node loaded = json_import.load(str);
+  const Sequence& loaded_seq = loaded["values"].sequence();
+  ASSERT_EQ(seq.size(), loaded_seq.size());
+  for (std::size_t i = 0; i < seq.size(); ++i)
+  {
+    ASSERT_TRUE(loaded_seq[i].isFloat());
+    EXPECT_EQ(seq[i].floatValue(), loaded_seq[i].floatValue());
+  }
+
+  EXPECT_EQ("{\"v\":[0.0,-0.0,0.1,1e-05,1e+17,10000000000000000.0,10.0,"
+            "-2.5]}",
+            json_export.dump(Node(Map({ { "v", Sequence({ 0.0, -0.0, 0.1,
+                1e-5, 1e17, 1e16, 10.0, -2.5 }) } }))));
+}
+
+TEST(JSON, StringEscaping)
+{
+  // special characters at every position relative to the scan blocks
+  const String specials("\"\\/\b\f\n\r\t\x01\x1f", 10);
+  const char* escaped[] = { "\\\"", "\\\\", "\\/", "\\b", "\\f", "\\n", "\\r",
+                            "\\t", "\\u0001", "\\u001f" };
+  JsonExport json_export;
+  for (std::size_t length = 1; length < 40; ++length)
+  {
+    for (std::size_t pos = 0; pos < length; ++pos)
+    {
+      for (std::size_t i = 0; i < specials.size(); ++i)
+      {
+        String str(length, '\x7f');
+        str[pos] = specials[i];
+        String exp = str;
+        exp.replace(pos, 1, escaped[i]);
+
+        Node node(Map({ { "s", str } }));
+        ASSERT_EQ("{\"s\":\"" + exp + "\"}", json_export.dump(node));
+      }
+    }
+  }
+
+  // long clean strings and non-ASCII bytes are copied as-is
+  String str(1000, 'a');
+  str += "\xc3\xa4\xe2\x82\xac";
+  EXPECT_EQ("{\"s\":\"" + str + "\"}",
+            json_export.dump(Node(Map({ { "s", str } }))));
+}
+
+TEST(JSON, Writer)
+{
+  // the same output as JsonExport
+  for (unsigned indent : { 0u, 2u })
+  {
+    std::stringstream sstrm;
+    JsonWriter writer(sstrm, indent);
+    writer.beginMap();
+    writer.key("a");
+    writer.null();
+    writer.key("b");
+    writer.value(true);
+    writer.key("c");
+    writer.value(25);
+    writer.key("d");
+    writer.value(99.0);
+    writer.key("e");
+    writer.value("str with ä and / } \" \\ special\n \u0001 chars");
+    writer.key("f");
+    writer.beginSequence();
+    writer.value(false);
+    writer.value(3.141592653589793);
+    writer.value(6u);
+    writer.endSequence();
+    writer.key("g");
+    writer.value(Node(Map({ {"aa", 5},
+                            {"bb", std::numeric_limits<double>::infinity() }
+                          })));
+    EXPECT_FALSE(writer.complete());
+    writer.endMap();
+    EXPECT_TRUE(writer.complete());
+
+    JsonExport json_export;
+    json_export.setIndent(indent);
+    EXPECT_EQ(json_export.dump(buildTestNode()), sstrm.str());
+  }
+
+  // complete nodes as top-level value
+  std::stringstream sstrm;
+  JsonWriter writer(sstrm);
+  writer.value(buildTestNode());
+  EXPECT_TRUE(writer.complete());
+  EXPECT_EQ(JsonExport().dump(buildTestNode()), sstrm.str());
+  EXPECT_THROW(writer.beginMap(), Exception);
+}
+
+TEST(JSON, WriterErrors)
+{
+  std::stringstream sstrm;
+  JsonWriter writer(sstrm);
+
+  // The top-level value must be a map
+  EXPECT_THROW(writer.beginSequence(), TypeException);
+  EXPECT_THROW(writer.value(5), TypeException);
+  EXPECT_THROW(writer.key("a"), Exception);
+
+  writer.beginMap();
+  EXPECT_THROW(writer.value(5), Exception); // no key
+  EXPECT_THROW(writer.endSequence(), Exception);
+  writer.key("a");
+  EXPECT_THROW(writer.key("b"), Exception);
+  EXPECT_THROW(writer.endMap(), Exception);
+  writer.beginSequence();
+  EXPECT_THROW(writer.key("b"), Exception);
+  EXPECT_THROW(writer.value(18446744073709551615ull), OverflowException);
+  writer.value(1);
+  writer.endSequence();
+  writer.endMap();
+  EXPECT_EQ("{\"a\":[1]}", sstrm.str());
+}
+
+TEST(JSON, WriterFileDescriptor)
+{
+  std::FILE* file = std::tmpfile();
+  ASSERT_NE(nullptr, file);
+  {
+    JsonWriter writer(fileno(file));
+    writer.beginMap();
+    writer.key("points");
+    writer.beginSequence();
+    for (int i = 0; i < 100000; ++i)
+    {
+      writer.value(i * 0.5);
+    }
+    writer.endSequence();
+    writer.endMap();
+  }
+
+  std::rewind(file);
+  String content;
+  char buffer[4096];
+  std::size_t length;
+  while ((length = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+  {
+    content.append(buffer, length);
+  }
+  std::fclose(file);
+
+  Node node = JsonImport().load(content);
+  ASSERT_EQ(100000u, node["points"].size());
+  EXPECT_EQ(4999.5, node["points"][9999].floatValue());
+}
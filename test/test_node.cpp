@@ -1,3 +1,5 @@
+#include <thread>
+#include <vector>
 #include <gtest/gtest.h>
 #include "cpds/node.hpp"
 #include "cpds/exception.hpp"
@@ -454,3 +456,277 @@ TEST(Node, Merge)
 
   EXPECT_EQ(5.6, node1.floatValue());
 }
+
+TEST(Node, MergeLayers)
+{
+  Node base(Map({ { "a", 1 },
+                  { "b", Map({ {"x", 1}, {"y", Sequence({1, 2})} }) },
+                  { "c", Sequence({ 1, 2, 3 }) }
+                }));
+  Node layer1(Map({ { "b", Map({ {"y", Sequence({5})}, {"z", "str"} }) },
+                    { "d", true }
+                  }));
+  Node layer2(Map({ { "a", 2.5 },
+                    { "b", Map({ {"x", Node()} }) },
+                    { "c", Sequence({ 7, 8, 9, 10 }) },
+                    { "e", Map({ {"k", 3} }) }
+                  }));
+  Node layer3(Map({ { "d", false },
+                    { "e", Map({ {"l", 4} }) }
+                  }));
+
+  // the result must match successive pairwise merges
+  Node refnode = base;
+  refnode.merge(layer1);
+  refnode.merge(layer2);
+  refnode.merge(layer3);
+
+  Node node = base;
+  node.merge({ &layer1, &layer2, &layer3 });
+  EXPECT_EQ(refnode, node);
+  EXPECT_EQ(base.id(), node.id());
+  EXPECT_EQ(layer2["e"].id(), node["e"].id());
+
+  // no layers
+  node = base;
+  node.merge(std::vector<const Node*>());
+  EXPECT_EQ(base, node);
+
+  // merging a node into itself uses its state prior to the merge
+  node = base;
+  node.merge({ &layer1, &node });
+  refnode = base;
+  refnode.merge(layer1);
+  refnode.merge(base);
+  EXPECT_EQ(refnode, node);
+
+  // the merge behaviour when a sequence / map is involved
+  Node n1 = Map({ { "a", Sequence() } });
+  Node n2 = Map({ { "a", 5 } });
+  Node n3 = Map({ { "a", true } });
+  node = n1;
+  EXPECT_THROW(node.merge({ &n3, &n2 }), TypeException);
+  node = n3;
+  EXPECT_THROW(node.merge({ &n2, &n1 }), TypeException);
+  node = n3;
+  EXPECT_NO_THROW(node.merge(std::vector<const Node*>{ &n2 }));
+  EXPECT_EQ(5, node["a"].intValue());
+}
+
+TEST(Node, ParallelMergeLayers)
+{
+  Map m1, m2, m3;
+  for (int i = 0; i < 1000; ++i)
+  {
+    String key = std::to_string(i);
+    m1.emplace_back(key, Map({ { "v", i }, { "w", Sequence({i}) } }));
+    if (i % 2 == 0)
+    {
+      m2.emplace_back(key, Map({ { "v", -i }, { "x", "even" } }));
+    }
+    if (i % 3 == 0)
+    {
+      m3.emplace_back(key, Map({ { "w", Sequence({0, 1}) } }));
+    }
+  }
+  Node base(std::move(m1));
+  Node layer1(std::move(m2));
+  Node layer2(std::move(m3));
+
+  Node refnode = base;
+  refnode.merge(layer1);
+  refnode.merge(layer2);
+
+  Node node = base;
+  node.merge({ &layer1, &layer2 }, 4);
+  EXPECT_EQ(refnode, node);
+}
+
+TEST(Node, DeepNesting)
+{
+  // alternating sequences and maps, deep enough to overflow a recursion
+  const int depth = 200000;
+  Node node = Sequence();
+  Node* cur = &node;
+  for (int i = 0; i < depth; ++i)
+  {
+    if (cur->isSequence())
+    {
+      cur->sequence().push_back(Map());
+      cur = &cur->sequence().back();
+    }
+    else
+    {
+      cur = &((*cur)["k"] = Sequence());
+    }
+  }
+  cur->sequence().push_back(5);
+
+  Node copy(node);
+  EXPECT_EQ(node, copy);
+
+  Node other = node;
+  Node* leaf = &other;
+  while (leaf->size() > 0)
+  {
+    leaf = leaf->isSequence() ? &leaf->sequence().back() : &leaf->at("k");
+  }
+  *leaf = 6;
+  EXPECT_NE(node, other);
+
+  copy.merge(other);
+  EXPECT_EQ(other, copy);
+
+  copy = node;
+  copy.merge({ &other, &node });
+  EXPECT_EQ(node, copy);
+}
+
+TEST(Node, Revision)
+{
+  Node scalar(5);
+  EXPECT_EQ(0u, scalar.revision());
+
+  Node node = Map({{"a", Sequence({1, 2})}, {"b", 3}});
+  const Node& cnode = node;
+  uint64_t rev = node.revision();
+  uint64_t child_rev = cnode.at("a").revision();
+  EXPECT_NE(0u, rev);
+  EXPECT_NE(rev, child_rev);
+
+  // const access does not change the revision
+  EXPECT_EQ(2, cnode.at("a")[1].intValue());
+  EXPECT_EQ(rev, node.revision());
+  EXPECT_EQ(child_rev, cnode.at("a").revision());
+
+  // non-const lookups hand out the children for modification
+  EXPECT_TRUE(node.at("a").isSequence());
+  EXPECT_NE(rev, node.revision());
+  rev = node.revision();
+  EXPECT_TRUE(node.find("b") != node.end());
+  EXPECT_NE(rev, node.revision());
+  rev = node.revision();
+
+  // modifications change the revision along the path
+  node["a"][1] = 4;
+  EXPECT_NE(rev, node.revision());
+  EXPECT_NE(child_rev, cnode.at("a").revision());
+
+  rev = node.revision();
+  node.erase("b");
+  EXPECT_NE(rev, node.revision());
+
+  rev = node.revision();
+  node.merge(Node(Map({{"c", 1}})));
+  EXPECT_NE(rev, node.revision());
+
+  // copies are separate containers
+  Node copy(node);
+  EXPECT_NE(node.revision(), copy.revision());
+
+  rev = node.revision();
+  Node moved(std::move(node));
+  EXPECT_EQ(rev, moved.revision());
+  moved.touch();
+  EXPECT_NE(rev, moved.revision());
+}
+
+TEST(Node, Share)
+{
+  Node node = Map({{"a", Sequence({1, Map({{"x", "y"}})})}, {"b", 3}});
+  const Node& cnode = node;
+  EXPECT_FALSE(node.isShared());
+
+  Node shared = cnode.share();
+  EXPECT_TRUE(node.isShared());
+  EXPECT_TRUE(shared.isShared());
+  EXPECT_EQ(node.id(), shared.id());
+  EXPECT_EQ(&cnode.map(), &static_cast<const Node&>(shared).map());
+  EXPECT_EQ(node, shared);
+
+  // copies of shared data share it as well, copies of other data do not
+  Node copy(shared);
+  EXPECT_EQ(&cnode.map(), &static_cast<const Node&>(copy).map());
+  Node parent = Sequence({shared, shared});
+  const Node& cparent = parent;
+  EXPECT_EQ(&cnode.map(), &cparent[1].map());
+  Node parent_copy(parent);
+  EXPECT_NE(&cparent.sequence(), &static_cast<const Node&>(parent_copy)
+                                    .sequence());
+  EXPECT_EQ(&cnode.map(), &static_cast<const Node&>(parent_copy)[0].map());
+
+  // modifications detach a private copy, the children remain shared
+  shared["b"] = 4;
+  EXPECT_NE(&cnode.map(), &static_cast<const Node&>(shared).map());
+  EXPECT_EQ(3, cnode.at("b").intValue());
+  EXPECT_EQ(4, shared.at("b").intValue());
+  EXPECT_TRUE(cnode.at("a").isShared());
+  shared["a"][1]["x"] = "z";
+  EXPECT_EQ("y", cnode.at("a")[1].at("x").stringValue());
+  EXPECT_EQ("z", shared.at("a")[1].at("x").stringValue());
+  EXPECT_EQ("y", cparent[0].at("a")[1].at("x").stringValue());
+
+  // const lookups do not detach, non-const ones do
+  const Node& ccopy = copy;
+  EXPECT_EQ(3, ccopy.at("b").intValue());
+  EXPECT_TRUE(ccopy.find("a") != ccopy.end());
+  EXPECT_EQ(&cnode.map(), &ccopy.map());
+  copy.at("b") = 6;
+  EXPECT_NE(&cnode.map(), &ccopy.map());
+  EXPECT_EQ(3, cnode.at("b").intValue());
+  copy = cnode;
+  copy.find("b")->second = 7;
+  EXPECT_EQ(3, cnode.at("b").intValue());
+  EXPECT_EQ(7, ccopy.at("b").intValue());
+  copy = cnode;
+  EXPECT_TRUE(copy.end() != copy.find("b"));
+  EXPECT_NE(&cnode.map(), &ccopy.map());
+
+  // merges detach as well
+  parent[0].merge(Node(Map({{"c", 5}})));
+  EXPECT_FALSE(cparent[1].find("c") != cparent[1].end());
+  EXPECT_EQ(5, cparent[0].at("c").intValue());
+
+  // the last owner is exclusive again
+  copy = Node();
+  parent = Node();
+  parent_copy = Node();
+  EXPECT_FALSE(node.isShared());
+
+  // scalars are copied
+  Node scalar("text");
+  EXPECT_FALSE(scalar.share().isShared());
+  EXPECT_EQ(scalar, scalar.share());
+}
+
+TEST(Node, ConcurrentLookup)
+{
+  // lookups through const references of shared data write nothing
+  Node data = Map({{"x", Sequence({1, 2})}, {"y", "text"}});
+  Node node = Map({{"a", data.share()}, {"b", data.share()}});
+  const Node& cnode = node;
+  const void* storage = &static_cast<const Node&>(data).map();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+  {
+    threads.emplace_back([&cnode]()
+    {
+      for (int i = 0; i < 1000; ++i)
+      {
+        const Node& a = cnode.at("a");
+        EXPECT_EQ(2u, a.at("x").size());
+        EXPECT_TRUE(a.find("y") != a.end());
+        EXPECT_TRUE(cnode.at("b").find("z") == cnode.at("b").end());
+      }
+    });
+  }
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  EXPECT_TRUE(cnode.at("a").isShared());
+  EXPECT_EQ(storage, &cnode.at("a").map());
+  EXPECT_EQ(storage, &cnode.at("b").map());
+}
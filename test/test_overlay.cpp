@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include "cpds/node.hpp"
+#include "cpds/overlay.hpp"
+#include "cpds/exception.hpp"
+
+using namespace cpds;
+
+// enforce local linkage
+namespace {
+
+Node buildBaseNode()
+{
+  Node node(Map({ { "a", 1 },
+                  { "b", Map({ {"x", 1}, {"y", Sequence({1, 2})} }) },
+                  { "c", Sequence({ 1, 2, 3 }) },
+                  { "s", "base" }
+                }));
+  return node;
+}
+
+Node buildLayerNode()
+{
+  Node node(Map({ { "a", 2.5 },
+                  { "b", Map({ {"y", Sequence({5})}, {"z", "str"} }) },
+                  { "c", Sequence({ 7, 8, 9, 10 }) },
+                  { "d", true }
+                }));
+  return node;
+}
+
+} // unnamed namespace
+
+TEST(OverlayView, Lookup)
+{
+  Node base = buildBaseNode();
+  Node layer = buildLayerNode();
+  OverlayView view({ base, layer });
+
+  EXPECT_TRUE(view.isMap());
+  EXPECT_EQ(5, view.size());
+  EXPECT_DOUBLE_EQ(2.5, view["a"].floatValue());
+  EXPECT_EQ(1, view["b"]["x"].intValue());
+  EXPECT_EQ(5, view["b"]["y"][0].intValue());
+  EXPECT_EQ(2, view["b"]["y"][1].intValue());
+  EXPECT_EQ(2, view["b"]["y"].size());
+  EXPECT_EQ("str", view["b"]["z"].stringValue());
+  EXPECT_EQ(4, view.at("c").size());
+  EXPECT_EQ(10, view.at("c")[3].intValue());
+  EXPECT_TRUE(view["d"].boolValue());
+  EXPECT_EQ("base", view["s"].stringValue());
+
+  EXPECT_TRUE(view.find("b") != view.end());
+  EXPECT_TRUE(view.find("e") == view.end());
+  EXPECT_THROW(view.at("e"), KeyException);
+  EXPECT_THROW(view["c"][4], KeyException);
+  EXPECT_THROW(view["a"][0], TypeException);
+  EXPECT_THROW(view["c"]["a"], TypeException);
+
+  // the merged node is identical
+  Node refnode = base;
+  refnode.merge(layer);
+  EXPECT_EQ(refnode, view.materialize());
+  EXPECT_EQ(refnode["b"], view["b"].materialize());
+}
+
+TEST(OverlayView, Iteration)
+{
+  Node base = buildBaseNode();
+  Node layer = buildLayerNode();
+  OverlayView view({ base, layer });
+
+  Node refnode = base;
+  refnode.merge(layer);
+
+  std::size_t idx = 0;
+  const Map& refmap = static_cast<const Node&>(refnode).map();
+  for (OverlayEntry entry : view)
+  {
+    ASSERT_LT(idx, refmap.size());
+    EXPECT_EQ(refmap[idx].first, entry.first);
+    EXPECT_EQ(refmap[idx].second, entry.second.materialize());
+    idx++;
+  }
+  EXPECT_EQ(refmap.size(), idx);
+}
+
+TEST(OverlayView, MergeRules)
+{
+  Node n1 = Map({ { "a", Sequence() } });
+  Node n2 = Map({ { "a", 5 } });
+  Node n3 = Map({ { "a", true } });
+
+  OverlayView view({ n1, n2 });
+  EXPECT_THROW(view["a"], TypeException);
+  Node n4 = 5;
+  EXPECT_THROW(OverlayView({ n1, n4 }), TypeException);
+
+  OverlayView scalars({ n3, n2 });
+  EXPECT_EQ(5, scalars["a"].intValue());
+  EXPECT_EQ(1, scalars["a"].layers().size());
+
+  EXPECT_THROW(OverlayView(std::vector<const Node*>()), Exception);
+}
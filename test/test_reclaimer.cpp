@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include "cpds/node.hpp"
+#include "cpds/reclaimer.hpp"
+
+using namespace cpds;
+
+// enforce local linkage
+namespace {
+
+Node buildTree(int size)
+{
+  Sequence seq;
+  for (int i = 0; i < size; ++i)
+  {
+    seq.push_back(Map({ { "a", i }, { "b", Sequence({ "str", 1.5 }) } }));
+  }
+  return Node(std::move(seq));
+}
+
+} // unnamed namespace
+
+TEST(Reclaimer, Deferred)
+{
+  Reclaimer reclaimer(Reclaimer::Mode::Deferred);
+  EXPECT_EQ(Reclaimer::Mode::Deferred, reclaimer.mode());
+
+  Node node = buildTree(100);
+  uint32_t id = node.id();
+  reclaimer.retire(std::move(node));
+  EXPECT_TRUE(node.isNull());
+  EXPECT_EQ(id, node.id());
+  EXPECT_EQ(1u, reclaimer.pending());
+
+  reclaimer.retire(buildTree(10));
+  reclaimer.retire(Node(5)); // destroyed in place
+  EXPECT_EQ(2u, reclaimer.pending());
+
+  EXPECT_EQ(2u, reclaimer.collect());
+  EXPECT_EQ(0u, reclaimer.pending());
+  EXPECT_EQ(0u, reclaimer.collect());
+
+  // destruction of the reclaimer releases the remaining trees
+  reclaimer.retire(buildTree(10));
+  EXPECT_EQ(1u, reclaimer.pending());
+}
+
+TEST(Reclaimer, Background)
+{
+  Reclaimer reclaimer;
+  EXPECT_EQ(Reclaimer::Mode::Background, reclaimer.mode());
+
+  for (int i = 0; i < 20; ++i)
+  {
+    reclaimer.retire(buildTree(1000));
+  }
+  reclaimer.flush();
+  EXPECT_EQ(0u, reclaimer.pending());
+
+  reclaimer.retire(buildTree(1000)); // pending at destruction
+}
+
+TEST(Reclaimer, ReleaseAsync)
+{
+  Node node = Map({ { "tree", buildTree(1000) } });
+  node.releaseAsync();
+  EXPECT_TRUE(node.isNull());
+
+  Reclaimer::global().flush();
+  EXPECT_EQ(0u, Reclaimer::global().pending());
+}
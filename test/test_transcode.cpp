@@ -0,0 +1,93 @@
+#include <sstream>
+#include <gtest/gtest.h>
+#include "cpds/node.hpp"
+#include "cpds/json.hpp"
+#include "cpds/yaml.hpp"
+#include "cpds/transcode.hpp"
+#include "cpds/exception.hpp"
+
+using namespace cpds;
+
+// enforce local linkage
+namespace {
+
+std::string jsonToYaml(const std::string& json)
+{
+  std::stringstream in(json);
+  std::stringstream out;
+  cpds::jsonToYaml(in, out);
+  return out.str();
+}
+
+std::string yamlToJson(const std::string& yaml)
+{
+  std::stringstream in(yaml);
+  std::stringstream out;
+  cpds::yamlToJson(in, out);
+  return out.str();
+}
+
+} // unnamed namespace
+
+TEST(Transcode, JsonToYaml)
+{
+  // the keys are sorted, such that the output equals the one of YamlExport
+  const char* documents[] = {
+    "{}",
+    "{\"a\": 1}",
+    "{\"a\": [], \"b\": {}, \"c\": null, \"d\": \"str\", \"e\": \"12\"}",
+    "{\"a\": [1, 2.5, -3], \"b\": [1, 2, \"x\", 3], \"c\": [[1], [\"y\"]]}",
+    "{\"a\": [1, [2, 3], {\"k\": [4]}, 5e300], \"b\": {\"c\": {\"d\": true}}}",
+    "{\"a\": [{\"b\": [], \"c\": [false, null]}, [[]], [{}]]}",
+    "{\"a\": \"---\", \"b c\": \"d: e\", \"f\": \"\\n\\u00e4\"}",
+  };
+  for (const char* json : documents)
+  {
+    Node node = JsonImport().load(json);
+    EXPECT_EQ(YamlExport().dump(node), jsonToYaml(json)) << json;
+  }
+
+  // the key order of the input is kept
+  EXPECT_EQ("b: 1\na: 2", jsonToYaml("{\"b\": 1, \"a\": 2}"));
+  EXPECT_EQ("g: \"-.inf\"\nh: \"+.Inf\"",
+            jsonToYaml("{\"g\": \"-.inf\", \"h\": \"+.Inf\"}"));
+
+  EXPECT_THROW(jsonToYaml("[1, 2]"), ImportException);
+  EXPECT_THROW(jsonToYaml("{\"a\": [1, 2}"), ImportException);
+  EXPECT_THROW(jsonToYaml("{\"a\": 9223372036854775808}"), OverflowException);
+}
+
+TEST(Transcode, YamlToJson)
+{
+  const char* documents[] = {
+    "{}",
+    "a: 1",
+    "a: []\nb: {}\nc: ~\nd: str\ne: \"12\"\nf: 0x1f\ng: .inf\nh: yes",
+    "a: [1, 2.5, -3]\nb:\n  - 1\n  - x\n  - c: [[1], [y]]",
+    "a: &x\n  b: &y [1, {c: 2}]\n  c: *y\nd: *x\ne: [*y, *x]",
+    "&k bar: x\nfoo: *k",
+    "a: &x z\n*x : y",
+  };
+  for (const char* yaml : documents)
+  {
+    Node node = YamlImport().load(yaml);
+    EXPECT_EQ(JsonExport().dump(node), yamlToJson(yaml)) << yaml;
+  }
+
+  EXPECT_EQ("{\"b\":1,\"a\":2}", yamlToJson("b: 1\na: 2"));
+  EXPECT_EQ("{\"g\":\"-.inf\"}",
+            yamlToJson(jsonToYaml("{\"g\": \"-.inf\"}")));
+
+  // aliases to anchors that are not complete yet are rejected, as for import
+  EXPECT_THROW(yamlToJson("a: &x [1, *x]"), ImportException);
+  EXPECT_THROW(yamlToJson("a: [1, 2"), ImportException);
+  EXPECT_THROW(yamlToJson("[a]: 1"), ImportException);
+  EXPECT_THROW(yamlToJson("- 1\n- 2"), TypeException);
+  EXPECT_THROW(yamlToJson(""), TypeException);
+}
+
+TEST(Transcode, RoundTrip)
+{
+  std::string json = "{\"a\":[1,2.5,{\"b\":\"---\"}],\"c\":{\"d\":[]}}";
+  EXPECT_EQ(json, yamlToJson(jsonToYaml(json)));
+}
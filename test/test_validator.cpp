@@ -466,3 +466,199 @@ TEST(Validator, Complex)
 
   EXPECT_NO_THROW(vd1.validate(node));
 }
+
+TEST(Validator, Check)
+{
+  const Node node(Map({ { "a", Sequence({ 1, 2, true }) },
+                        { "b", 25 },
+                        { "c", 2.5 } }));
+  ValidationResult result;
+
+  EXPECT_TRUE(MapType().check(node, result));
+  EXPECT_TRUE(result.valid());
+
+  EXPECT_FALSE(BooleanType().check(node, result));
+  EXPECT_EQ(ValidationResult::Error::Type, result.error());
+  EXPECT_EQ(&node, result.node());
+  EXPECT_THROW(result.raise(), TypeException);
+
+  result.clear();
+  EXPECT_TRUE(result.valid());
+  EXPECT_EQ(nullptr, result.node());
+
+  // the failing node within the tree is reported
+  Validator v1 = MapType(MapGroup({ { "b", IntegerType(0, 10), Required } }));
+  EXPECT_FALSE(v1.check(node, result));
+  EXPECT_EQ(ValidationResult::Error::IntRange, result.error());
+  EXPECT_EQ(&node.at("b"), result.node());
+  EXPECT_THROW(result.raise(), IntRangeException);
+
+  Validator v2 = MapType(MapGroup({ { "c", FloatingPointType(0.0, 1.0),
+                                      Required } }));
+  EXPECT_FALSE(v2.check(node, result));
+  EXPECT_EQ(ValidationResult::Error::FloatRange, result.error());
+  EXPECT_THROW(result.raise(), FloatRangeException);
+
+  Validator v3 = MapType(MapGroup({ { "a", SequenceType(IntegerType()),
+                                      Required } }));
+  EXPECT_FALSE(v3.check(node, result));
+  EXPECT_EQ(ValidationResult::Error::Validation, result.error());
+  EXPECT_EQ(&node.at("a").sequence()[2], result.node());
+  EXPECT_EQ("sequence child failed to validate", result.message());
+
+  Validator v4 = MapType(MapGroup({ { "a", SequenceType(), Required },
+                                    { "b", IntegerType(), Required } },
+                                  NoMoreEntries));
+  EXPECT_FALSE(v4.check(node, result));
+  EXPECT_EQ("extra key 'c' present in map", result.message());
+  EXPECT_THROW(result.raise(), ValidationException);
+
+  // custom functions still throw, the exception is kept
+  Validator v5 = MapType(MapGroup({ { "b", IntegerType(evenInt),
+                                      Required } }));
+  EXPECT_FALSE(v5.check(node, result));
+  EXPECT_EQ(ValidationResult::Error::Exception, result.error());
+  EXPECT_EQ("number is not even", result.message());
+  EXPECT_THROW(result.raise(), ValidationException);
+  EXPECT_THROW(v5.validate(node), ValidationException);
+
+  Validator v6 = MapType(MapGroup({ }, AllowMoreEntries, hasTrueA));
+  EXPECT_FALSE(v6.check(node, result)); // "a" is not a boolean
+  EXPECT_EQ(ValidationResult::Error::Exception, result.error());
+  EXPECT_THROW(result.raise(), TypeException);
+}
+
+TEST(Validator, MapGroupOrder)
+{
+  // the entries are declared out of order, "b" appears twice
+  MapGroup group({ { "d", IntegerType(), Optional },
+                   { "b", IntegerType(0, 10), Required },
+                   { "a", NullType(), Optional },
+                   { "b", IntegerType(evenInt), Required } },
+                 NoMoreEntries);
+  ASSERT_EQ(4u, group.entries().size());
+  EXPECT_EQ("a", group.entries()[0].key());
+  EXPECT_EQ("d", group.entries()[3].key());
+
+  Validator val = MapType(group);
+  EXPECT_NO_THROW(val.validate(Map({ { "b", 4 } })));
+  EXPECT_NO_THROW(val.validate(Map({ { "a", Node() }, { "b", 4 },
+                                     { "d", 1 } })));
+  EXPECT_THROW(val.validate(Map({ { "b", 5 } })), ValidationException);
+  EXPECT_THROW(val.validate(Map({ { "b", 12 } })), IntRangeException);
+  EXPECT_THROW(val.validate(Map({ { "a", Node() } })), ValidationException);
+  EXPECT_THROW(val.validate(Map({ { "b", 4 }, { "c", 1 } })),
+               ValidationException);
+  EXPECT_THROW(val.validate(Map({ { "b", 4 }, { "e", 1 } })),
+               ValidationException);
+  EXPECT_THROW(val.validate(Map({ { "0", 1 }, { "b", 4 } })),
+               ValidationException);
+  EXPECT_THROW(val.validate(Sequence()), TypeException);
+}
+
+TEST(Validator, MapGroupDiscriminator)
+{
+  MapGroup pinhole({ { "focal", FloatingPointType(), Required } },
+                   NoMoreEntries, "type", "pinhole");
+  MapGroup fisheye({ { "focal", FloatingPointType(), Required },
+                     { "xi", FloatingPointType(0.0, 1.0), Required } },
+                   NoMoreEntries, "type", "fisheye");
+  ASSERT_TRUE(pinhole.hasDiscriminator());
+  ASSERT_EQ(2u, pinhole.entries().size());
+  EXPECT_EQ("type", pinhole.entries()[1].key());
+  EXPECT_EQ(Required, pinhole.entries()[1].requiredness());
+  EXPECT_EQ(Check, pinhole.check(Map({ { "type", "pinhole" } })));
+  EXPECT_EQ(Invalid, pinhole.check(Map({ { "type", "fisheye" } })));
+  EXPECT_EQ(Invalid, pinhole.check(Sequence()));
+
+  Validator val = MapType({ pinhole, fisheye });
+  EXPECT_NO_THROW(val.validate(Map({ { "type", "pinhole" },
+                                     { "focal", 2.0 } })));
+  EXPECT_NO_THROW(val.validate(Map({ { "type", "fisheye" },
+                                     { "focal", 2.0 }, { "xi", 0.5 } })));
+  EXPECT_THROW(val.validate(Map({ { "type", "pinhole" }, { "focal", 2.0 },
+                                  { "xi", 0.5 } })), ValidationException);
+  EXPECT_THROW(val.validate(Map({ { "type", "fisheye" }, { "focal", 2.0 },
+                                  { "xi", 2.0 } })), FloatRangeException);
+  EXPECT_THROW(val.validate(Map({ { "type", "other" } })),
+               ValidationException);
+  EXPECT_THROW(val.validate(Map({ { "type", 1 } })), ValidationException);
+  EXPECT_THROW(val.validate(Map({ { "focal", 2.0 } })), ValidationException);
+  EXPECT_THROW(val.validate(Sequence()), TypeException);
+
+  // mixed with a group that is checked for all maps
+  Validator mixed = MapType({ pinhole, MapGroup({ { "id", IntegerType(),
+                                                    Optional } }) });
+  EXPECT_NO_THROW(mixed.validate(Map({ { "type", "other" } })));
+  EXPECT_THROW(mixed.validate(Map({ { "type", "pinhole" } })),
+               ValidationException);
+  EXPECT_THROW(mixed.validate(Map({ { "id", true } })), TypeException);
+
+  // only the discriminator constructor creates discriminator groups
+  EXPECT_FALSE(MapGroup({ }, AllowMoreEntries, hasKeyB).hasDiscriminator());
+  EXPECT_TRUE(MapGroup({ }, AllowMoreEntries, "", "").hasDiscriminator());
+  EXPECT_THROW(MapGroup({ }, AllowMoreEntries, nullptr), Exception);
+}
+
+TEST(Validator, Parallel)
+{
+  Sequence seq;
+  for (Int i = 0; i < 5000; ++i)
+  {
+    seq.push_back(i);
+  }
+  Node node(seq);
+  Validator val = SequenceType(IntegerType(0, 10000));
+  EXPECT_NO_THROW(val.validate(node, 4));
+
+  // the failure of the lowest index is reported
+  node.sequence()[4000] = "x";
+  node.sequence()[3000] = true;
+  ValidationResult result;
+  for (unsigned num_threads : { 1u, 4u, 0u })
+  {
+    EXPECT_FALSE(val.check(node, result, num_threads));
+    EXPECT_EQ(&node.sequence()[3000], result.node());
+  }
+  EXPECT_THROW(val.validate(node, 4), ValidationException);
+
+  // custom functions are called concurrently, their exceptions are kept
+  Validator even = SequenceType(IntegerType(evenInt));
+  EXPECT_FALSE(even.check(Node(seq), result, 4));
+  EXPECT_EQ(ValidationResult::Error::Validation, result.error());
+
+  // values of a map with a large sequence, the lowest key is reported
+  Node map = Map();
+  MapEntryTypeVector entries;
+  for (Int i = 0; i < 2000; ++i)
+  {
+    String key = std::to_string(10000 + i);
+    map[key] = i;
+    entries.emplace_back(key, IntegerType(0, 10000), Required);
+  }
+  map["10500"] = -1;
+  map["10700"] = "x";
+  map["20000"] = Sequence(seq);
+  entries.emplace_back("20000", SequenceType(IntegerType()), Required);
+  Validator map_val = MapType(MapGroup(entries, NoMoreEntries));
+  for (unsigned num_threads : { 1u, 4u })
+  {
+    EXPECT_FALSE(map_val.check(map, result, num_threads));
+    EXPECT_EQ(ValidationResult::Error::IntRange, result.error());
+  }
+  map["10500"] = 1;
+  map["10700"] = 2;
+  EXPECT_NO_THROW(map_val.validate(map, 4));
+
+  // a failure of the large value precedes a later extra key
+  map["20000"] = Sequence({ "x" });
+  map["30000"] = 1;
+  for (unsigned num_threads : { 1u, 4u })
+  {
+    EXPECT_FALSE(map_val.check(map, result, num_threads));
+    EXPECT_EQ("sequence child failed to validate", result.message());
+  }
+  map["20000"] = Sequence(seq);
+  EXPECT_FALSE(map_val.check(map, result, 4));
+  EXPECT_EQ("extra key '30000' present in map", result.message());
+}
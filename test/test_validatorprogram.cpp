@@ -0,0 +1,157 @@
+#include <cmath>
+#include <gtest/gtest.h>
+#include "cpds/node.hpp"
+#include "cpds/validatorprogram.hpp"
+#include "cpds/exception.hpp"
+
+using namespace cpds;
+
+// enforce local linkage
+namespace {
+
+void evenInt(const Node& node, const Validator& /*validator*/)
+{
+  if (node.intValue() % 2 != 0)
+  {
+    throw ValidationException("number is not even", node);
+  }
+}
+
+GroupEnableResult hasKeyB(const Node& node)
+{
+  if (node.find("b") != node.end())
+  {
+    return Check;
+  }
+  return Invalid;
+}
+
+bool accepts(const Validator& validator, const Node& node)
+{
+  try
+  {
+    validator.validate(node);
+    return true;
+  }
+  catch (Exception&)
+  {
+    return false;
+  }
+}
+
+bool accepts(const ValidatorProgram& program, const Node& node)
+{
+  try
+  {
+    program.validate(node);
+    return true;
+  }
+  catch (Exception&)
+  {
+    return false;
+  }
+}
+
+} // unnamed namespace
+
+TEST(ValidatorProgram, SameResult)
+{
+  std::vector<Node> nodes = {
+    Node(), true, 6, 17, -4.0, 2.5, std::nan(""), "", "str",
+    Sequence({1, 2, 3}), Sequence({true, 2}), Sequence({2.5, 4}),
+    Map(), Map({ {"a", Node()} }), Map({ {"a", Node()}, {"b", false} }),
+    Map({ {"a", true}, {"b", 6} }), Map({ {"b", 5}, {"c", 8}, {"d", 1} }),
+    Map({ {"a", Sequence({Map({ {"x", 2} }), 4})}, {"b", 3} }),
+    Map({ {"a", "x"}, {"b", 2} }), Map({ {"a", "y"}, {"c", 2} }),
+    Map({ {"a", "z"} }), Map({ {"a", "x"}, {"b", 2}, {"c", 3} }),
+  };
+
+  std::vector<Validator> validators = {
+    NullType(), BooleanType(), IntegerType(), IntegerType(0, 10),
+    IntegerType(evenInt), FloatingPointType(), FloatingPointType(0.0, 10.0),
+    StringType(), SequenceType(), SequenceType(IntegerType()),
+    SequenceType({IntegerType(0, 1), IntegerType(2, 4)}),
+    SequenceType({BooleanType(), IntegerType(evenInt)}),
+    SequenceType(FloatingPointType(2.0, 5.0)),
+    MapType(),
+    MapType(MapGroup({ {"a", NullType(), Required} })),
+    MapType(MapGroup({ {"a", NullType(), Optional} }, NoMoreEntries)),
+    MapType(MapGroup({ {"b", IntegerType(), Required},
+                       {"a", BooleanType(), Required} }, NoMoreEntries)),
+    MapType(MapGroup({ {"d", IntegerType(), Optional},
+                       {"b", IntegerType(), Required} }, NoMoreEntries)),
+    MapType(MapGroup({}, NoMoreEntries)),
+    MapType(MapGroup({}, AllowMoreEntries, hasKeyB)),
+    MapType({ MapGroup({ {"a", NullType(), Required} }),
+              MapGroup({ {"c", IntegerType(evenInt), Required} }) }),
+    MapType(MapGroup({ {"a", SequenceType({
+                               MapType(MapGroup({ {"x", IntegerType(),
+                                                   Required} })),
+                               IntegerType(0, 5)}), Required} })),
+    MapType({ MapGroup({ {"b", IntegerType(), Required} }, NoMoreEntries,
+                       "a", "x"),
+              MapGroup({ {"c", IntegerType(evenInt), Required} },
+                       NoMoreEntries, "a", "y") }),
+    MapType({ MapGroup({ {"b", IntegerType(0, 5), Optional} },
+                       AllowMoreEntries, "a", "x"),
+              MapGroup({ {"c", NullType(), Optional} }) }),
+    MapType({ MapGroup({ {"a", SequenceType(), Optional} }),
+              MapGroup({ {"b", MapType(MapGroup({ {"x", IntegerType(),
+                                                    Required} })),
+                          Optional} }) }),
+  };
+
+  for (std::size_t i = 0; i < validators.size(); ++i)
+  {
+    ValidatorProgram program(validators[i]);
+    for (std::size_t k = 0; k < nodes.size(); ++k)
+    {
+      EXPECT_EQ(accepts(validators[i], nodes[k]), accepts(program, nodes[k]))
+          << "validator " << i << ", node " << k;
+    }
+  }
+}
+
+TEST(ValidatorProgram, Exceptions)
+{
+  ValidatorProgram p1(IntegerType(0, 10));
+  EXPECT_THROW(p1.validate(17), IntRangeException);
+  EXPECT_THROW(p1.validate(true), TypeException);
+
+  ValidatorProgram p2(FloatingPointType(0.0, 10.0));
+  EXPECT_THROW(p2.validate(-4.0), FloatRangeException);
+  EXPECT_NO_THROW(p2.validate(3)); // integers convert
+
+  ValidatorProgram p3((SequenceType(StringType())));
+  EXPECT_THROW(p3.validate(Sequence({"a", 1})), ValidationException);
+  EXPECT_THROW(p3.validate(Map()), TypeException);
+
+  ValidatorProgram p4(MapType(MapGroup({ {"b", IntegerType(), Required},
+                                         {"a", NullType(), Required} },
+                                       NoMoreEntries)));
+  EXPECT_NO_THROW(p4.validate(Map({ {"a", Node()}, {"b", 1} })));
+  EXPECT_THROW(p4.validate(Map({ {"a", Node()} })), ValidationException);
+  EXPECT_THROW(p4.validate(Map({ {"a", Node()}, {"b", 1}, {"c", 1} })),
+               ValidationException);
+  EXPECT_THROW(p4.validate(Map({ {"a", 1}, {"b", 1} })), TypeException);
+
+  ValidationResult result;
+  EXPECT_FALSE(p4.check(Map({ {"a", Node()}, {"c", 1} }), result));
+  EXPECT_EQ(ValidationResult::Error::Validation, result.error());
+  EXPECT_FALSE(p1.check(-1, result));
+  EXPECT_EQ(ValidationResult::Error::IntRange, result.error());
+
+  // a nested map in a later group appends its entries first
+  ValidatorProgram p6(MapType({
+      MapGroup({ {"a", IntegerType(), Required} }),
+      MapGroup({ {"b", MapType(MapGroup({ {"x", StringType(), Required} })),
+                  Required} }) }));
+  EXPECT_NO_THROW(p6.validate(Map({ {"a", 1}, {"b", Map({ {"x", "s"} })} })));
+  EXPECT_THROW(p6.validate(Map({ {"a", 1}, {"b", Map({ {"x", 2} })} })),
+               TypeException);
+
+  // the program keeps working after a move
+  ValidatorProgram p5(std::move(p4));
+  EXPECT_NO_THROW(p5.validate(Map({ {"a", Node()}, {"b", 1} })));
+  EXPECT_EQ(3u, p5.size());
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include "cpds/node.hpp"
+#include "cpds/walker.hpp"
+
+using namespace cpds;
+
+// enforce local linkage
+namespace {
+
+// records the visitor calls in a compact textual form
+class Recorder
+{
+public:
+  void scalar(const Node& node) { events += node.isNull() ? "~" : "s"; }
+  void beginSequence(const Node&) { events += "["; }
+  void element(std::size_t index) { events += std::to_string(index); }
+  void endSequence(const Node&) { events += "]"; }
+  void beginMap(const Node&) { events += "{"; }
+  void key(const String& key, std::size_t) { events += key + ":"; }
+  void endMap(const Node&) { events += "}"; }
+
+  String events;
+}; // class Recorder
+
+} // unnamed namespace
+
+TEST(Walker, VisitOrder)
+{
+  Node node(Map({ { "a", Node() },
+                  { "b", Sequence({ 1, Sequence(), Map() }) },
+                  { "c", Map({ { "d", "str" } }) }
+                }));
+
+  Recorder recorder;
+  walk(node, recorder);
+  EXPECT_EQ("{a:~b:[0s1[]2{}]c:{d:s}}", recorder.events);
+
+  recorder.events.clear();
+  walk(Node(5), recorder);
+  EXPECT_EQ("s", recorder.events);
+}
+
+TEST(Walker, DeepNesting)
+{
+  const int depth = 200000;
+  Node node = Sequence();
+  Node* cur = &node;
+  for (int i = 0; i < depth; ++i)
+  {
+    cur->sequence().push_back(Sequence());
+    cur = &cur->sequence().back();
+  }
+
+  Recorder recorder;
+  walk(node, recorder);
+  ASSERT_EQ(static_cast<std::size_t>(3*depth + 2), recorder.events.size());
+  EXPECT_EQ("[0[0[", recorder.events.substr(0, 5));
+  EXPECT_EQ("]]]", recorder.events.substr(recorder.events.size()-3));
+}
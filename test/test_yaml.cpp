@@ -1,5 +1,7 @@
 #include <cmath>
+#include <cstring>
 #include <fstream>
+#include <sstream>
 #include <gtest/gtest.h>
 #include "cpds/node.hpp"
 #include "cpds/yaml.hpp"
@@ -34,6 +36,193 @@ TEST(YAML, DataExport)
         "\\n \\x01 chars\"\nf:\n  - false\n  - 3.141592653589793\n  - 6\n"
         "g:\n  aa: 5\n  bb: .inf";
   EXPECT_EQ(cmp, exp);
+
+  // numeric sequences use flow style
+  Node node(Map({ { "t", Sequence({0.5, -1, 2.0}) },
+                  { "m", Sequence({ Sequence({1, 0}), Sequence({0, 1}) }) },
+                  { "s", Sequence({1, "x"}) } }));
+  exp = yaml_export.dump(node);
+  cmp = "m:\n  - [1, 0]\n  - [0, 1]\ns:\n  - 1\n  - x\nt: [0.5, -1, 2.0]";
+  EXPECT_EQ(cmp, exp);
+  EXPECT_EQ(node, YamlImport().load(exp));
+
+  std::stringstream strm;
+  yaml_export.dump(strm, node);
+  EXPECT_EQ(cmp, strm.str());
+}
+
+TEST(YAML, DumpTo)
+{
+  YamlExport yaml_export;
+  String cmp = "b: true\nc: 25\nd: 99.2\ne: \"str with ä and / } \\\" "
+               "\\\\ special\\n \\x01 chars\"\nf:\n  - false\n"
+               "  - 3.141592653589793\n  - 6\ng:\n  aa: 5\n  bb: .inf";
+  char buffer[512];
+  std::size_t length = yaml_export.dumpTo(buffer, sizeof(buffer),
+                                          buildExportNode());
+  EXPECT_EQ(cmp, String(buffer, length));
+
+  // truncation
+  std::memset(buffer, 0, sizeof(buffer));
+  EXPECT_EQ(cmp.size(), yaml_export.dumpTo(buffer, 20, buildExportNode()));
+  EXPECT_EQ(cmp.substr(0, 20), String(buffer, 20));
+  EXPECT_EQ('\0', buffer[20]);
+  EXPECT_EQ(cmp.size(), yaml_export.dumpTo(nullptr, 0, buildExportNode()));
+
+  // layout and quoting, read back as the same data
+  Node node(Map({ { "empty", Map() },
+                  { "nested", Sequence({ Sequence({1, 2}), Sequence(),
+                                         Map({{"x", Node()}, {"y", "-"}}) }) },
+                  { "strings", Sequence({ "plain text", "a: b", "a #b", "#c",
+                                          " lead", "trail ", "key:", "- x",
+                                          "[x", "tab\tx", "C:\\dir",
+                                          "x\x7f", "null", "true", "",
+                                          "12", "0.5", ".inf" }) },
+                  { "quoted key: x", -1.5 } }));
+  length = yaml_export.dumpTo(buffer, sizeof(buffer), node);
+  ASSERT_LT(length, sizeof(buffer));
+  String str(buffer, length);
+  EXPECT_EQ(str, yaml_export.dump(node));
+  EXPECT_EQ(0u, str.find("empty: {}\nnested:\n  - [1, 2]\n  - []\n"
+                         "  - x: ~\n    y: \"-\"\n"));
+  EXPECT_NE(String::npos, str.find("\n  - plain text\n"));
+  EXPECT_NE(String::npos, str.find("\n\"quoted key: x\": -1.5"));
+  EXPECT_EQ(node, YamlImport().load(str));
+
+  // strings that read like special floating point values, and the values
+  const Float inf = std::numeric_limits<Float>::infinity();
+  node = Map({ { "strings", Sequence({ "-.inf", "+.inf", "-.Inf", "+.Inf",
+                                       "-.INF", "+.INF", ".NaN", "-.nan",
+                                       "+0x1", "0o7", "-1e5" }) },
+               { "floats", Sequence({ -inf, inf, 1e300 }) } });
+  str = yaml_export.dump(node);
+  EXPECT_NE(String::npos, str.find("  - \"-.inf\"\n  - \"+.inf\"\n"));
+  EXPECT_NE(String::npos, str.find("floats: [-.inf, .inf, 1e+300]"));
+  EXPECT_EQ(node, YamlImport().load(str));
+
+  // scalars and nesting limit
+  EXPECT_EQ(3u, yaml_export.dumpTo(buffer, sizeof(buffer), Node(1.0)));
+  EXPECT_EQ("1.0", String(buffer, 3));
+  Node deep;
+  for (int i = 0; i < 300; ++i)
+  {
+    deep = Sequence({std::move(deep)});
+  }
+  EXPECT_EQ(0u, yaml_export.dumpTo(buffer, sizeof(buffer), deep));
+}
+
+TEST(YAML, ParallelExport)
+{
+  Map map;
+  Sequence seq;
+  for (int i = 0; i < 500; ++i)
+  {
+    Node child(Map({{"a", Sequence({i, i * 0.25, "multi\nline"})},
+                    {"b", Map()},
+                    {"c", Sequence({Map({{"d", true}})})}}));
+    map.emplace_back("key" + std::to_string(i), child);
+    seq.push_back(std::move(child));
+  }
+
+  Sequence numbers;
+  for (int i = 0; i < 500; ++i)
+  {
+    numbers.push_back(i * 0.5);
+  }
+
+  for (const Node& node : { Node(std::move(map)), Node(std::move(seq)),
+                            Node(std::move(numbers)) })
+  {
+    YamlExport serial;
+    String expected = serial.dump(node);
+
+    YamlExport parallel;
+    parallel.setThreads(4);
+    EXPECT_EQ(expected, parallel.dump(node));
+  }
+}
+
+TEST(YAML, MultiDocument)
+{
+  Sequence documents;
+  for (int i = 0; i < 200; ++i)
+  {
+    documents.push_back(Map({{"index", i}, {"values", Sequence({i, 0.5})},
+                             {"name", "doc" + std::to_string(i)}}));
+  }
+  documents.push_back(Node());
+  documents.push_back(Map());
+  documents.push_back("--- text");
+  documents.push_back(Sequence({1, Sequence({2, 3})}));
+
+  YamlExport serial;
+  String str = serial.dumpAll(documents);
+  EXPECT_EQ(0u, str.find("---\nindex: 0\nname: doc0\nvalues: [0, 0.5]\n"
+                         "---\n"));
+  YamlExport parallel;
+  parallel.setThreads(4);
+  EXPECT_EQ(str, parallel.dumpAll(documents));
+  std::stringstream strm;
+  parallel.dumpAll(strm, documents);
+  EXPECT_EQ(str, strm.str());
+
+  // sequential and parallel parsing yield the same nodes and parse marks
+  YamlImport serial_import;
+  Sequence loaded = serial_import.loadAll(str);
+  ASSERT_EQ(documents.size(), loaded.size());
+  EXPECT_EQ(Node(documents), Node(loaded));
+
+  YamlImport parallel_import;
+  parallel_import.setThreads(4);
+  Sequence parallel_loaded = parallel_import.loadAll(str);
+  ASSERT_EQ(loaded.size(), parallel_loaded.size());
+  EXPECT_EQ(Node(loaded), Node(parallel_loaded));
+  for (std::size_t i = 0; i < loaded.size(); ++i)
+  {
+    const ParseMark& mk = serial_import.parseinfo().getMark(loaded[i]);
+    const ParseMark& pmk = parallel_import.parseinfo().getMark(
+                             parallel_loaded[i]);
+    EXPECT_EQ(mk.line(), pmk.line());
+    EXPECT_EQ(mk.position(), pmk.position());
+  }
+  const ParseMark& mk = parallel_import.parseinfo().getMark(
+                          parallel_loaded[1]["values"][1]);
+  EXPECT_EQ(8, mk.line());
+  EXPECT_EQ(13, mk.position());
+
+  // one document at a time
+  std::stringstream input(str);
+  std::size_t count = 0;
+  serial_import.forEachDocument(input, [&](Node& document)
+  {
+    ASSERT_LT(count, documents.size());
+    EXPECT_EQ(documents[count], document);
+    EXPECT_TRUE(serial_import.parseinfo().hasMark(document));
+    count++;
+  });
+  EXPECT_EQ(documents.size(), count);
+
+  // document end markers, directives and errors
+  for (unsigned threads : { 1u, 4u })
+  {
+    YamlImport yaml_import;
+    yaml_import.setThreads(threads);
+    Sequence result = yaml_import.loadAll("a: 1\n...\n---\nb: 2\n--- 5\n");
+    EXPECT_EQ(Node(Sequence({Map({{"a", 1}}), Map({{"b", 2}}), 5})),
+              Node(result));
+    result = yaml_import.loadAll("%YAML 1.2\n---\na: 1\n---\nb: 2\n");
+    EXPECT_EQ(2u, result.size());
+    EXPECT_TRUE(yaml_import.loadAll("").empty());
+    try
+    {
+      yaml_import.loadAll("a: 1\n---\nb: [1, 2\n");
+      ADD_FAILURE();
+    }
+    catch (const ImportException& e)
+    {
+      EXPECT_EQ(4, e.line());
+    }
+  }
 }
 
 TEST(YAML, DefaultDataImport)
@@ -73,6 +262,67 @@ TEST(YAML, DefaultDataImport)
   EXPECT_EQ(7, mk.position());
 }
 
+TEST(YAML, AliasImport)
+{
+  YamlImport yaml_import;
+  std::string str;
+  str = "base: &b\n  x: 1\n  y: [2, 3]\nname: &n key\n"
+        "copy: *b\nlist:\n  - *n\n  - *b\n*n : 4";
+
+  Node base(Map({ {"x", 1}, {"y", Sequence({2, 3})} }));
+  Node ref_node(Map({ { "base", base },
+                      { "name", "key" },
+                      { "copy", base },
+                      { "list", Sequence({"key", base}) },
+                      { "key", 4 }
+                    }));
+
+  Node node = yaml_import.load(str);
+  EXPECT_EQ(ref_node, node);
+
+  // aliases share the anchored node and its parse mark
+  const Node& cnode = node;
+  EXPECT_TRUE(cnode.at("copy").isShared());
+  EXPECT_EQ(&cnode.at("base").map(), &cnode.at("copy").map());
+  EXPECT_EQ(&cnode.at("base").map(), &cnode.at("list")[1].map());
+  EXPECT_EQ(cnode.at("base").id(), cnode.at("copy").id());
+  const ParseInfo& pi = yaml_import.parseinfo();
+  ParseMark mk = pi.getMark(node["copy"]);
+  EXPECT_EQ(1, mk.line());
+  EXPECT_EQ(7, mk.position());
+
+  // modifying a copy of an aliased subtree leaves the others unchanged
+  Node base_copy = node.at("base");
+  base_copy.at("x") = 7;
+  base_copy.find("y")->second.sequence().push_back(4);
+  node["copy"]["x"] = 8;
+  node["list"][1].at("y")[0] = 9;
+  EXPECT_EQ(7, base_copy.at("x").intValue());
+  EXPECT_EQ(Node(Sequence({2, 3, 4})), base_copy.at("y"));
+  EXPECT_EQ(8, cnode.at("copy").at("x").intValue());
+  EXPECT_EQ(Node(Sequence({9, 3})), cnode.at("list")[1].at("y"));
+  EXPECT_EQ(base, cnode.at("base"));
+
+  // anchored keys and aliases of scalars as keys use the scalar text
+  node = yaml_import.load("&a foo: bar\nbaz: *a");
+  EXPECT_EQ(Node(Map({ {"foo", "bar"}, {"baz", "foo"} })), node);
+  node = yaml_import.load("a: &x 5\n*x : y\nb: &z \"007\"\n*z : w");
+  EXPECT_EQ(Node(Map({ {"a", 5}, {"5", "y"}, {"b", "007"}, {"007", "w"} })),
+            node);
+  node = yaml_import.load("&k 12: a\nb: *k");
+  EXPECT_EQ(12, node.at("b").intValue());
+  EXPECT_THROW(yaml_import.load("a: &x [1]\n*x : y"), ImportException);
+
+  // undefined or recursive aliases and complex keys are rejected
+  EXPECT_THROW(yaml_import.load("a: *x"), ImportException);
+  EXPECT_THROW(yaml_import.load("a: &x [1, *x]"), ImportException);
+  EXPECT_THROW(yaml_import.load("? [1, 2]\n: 3"), ImportException);
+  EXPECT_THROW(yaml_import.load("a: [1, 2"), ImportException);
+
+  // an empty stream is null
+  EXPECT_TRUE(yaml_import.load("").isNull());
+}
+
 TEST(YAML, TagDeduction)
 {
   YamlImport yaml_import;
@@ -198,6 +448,61 @@ TEST(YAML, TagDeduction)
   str = "test";
   node = yaml_import.load(str);
   EXPECT_EQ("test", node.stringValue());
+
+  // integers beyond the range of Int
+  str = "9223372036854775807";
+  node = yaml_import.load(str);
+  EXPECT_EQ(std::numeric_limits<Int>::max(), node.intValue());
+
+  str = "-9223372036854775808";
+  node = yaml_import.load(str);
+  EXPECT_EQ(std::numeric_limits<Int>::min(), node.intValue());
+
+  str = "9223372036854775808";
+  node = yaml_import.load(str);
+  EXPECT_DOUBLE_EQ(9223372036854775808.0, node.floatValue());
+
+  str = "0x8000000000000000";
+  node = yaml_import.load(str);
+  EXPECT_TRUE(node.isString());
+
+  // float notations of the Core Schema
+  str = ".5";
+  node = yaml_import.load(str);
+  EXPECT_DOUBLE_EQ(0.5, node.floatValue());
+
+  str = "+12.";
+  node = yaml_import.load(str);
+  EXPECT_DOUBLE_EQ(12.0, node.floatValue());
+
+  str = "1E-3";
+  node = yaml_import.load(str);
+  EXPECT_DOUBLE_EQ(0.001, node.floatValue());
+
+  // not numbers according to the Core Schema
+  for (const char* text : { "+", ".", "1e", "1.5.2", "0x", "0o8", "-0x1",
+                            "1_000", "inf", "nan", "imu0", "TrUE" })
+  {
+    node = yaml_import.load(text);
+    EXPECT_TRUE(node.isString()) << text;
+    EXPECT_EQ(text, node.stringValue());
+  }
+
+  // quoted scalars are not resolved
+  for (const char* text : { "'null'", "\"true\"", "'12'", "\"0.5\"", "''" })
+  {
+    node = yaml_import.load(text);
+    EXPECT_TRUE(node.isString()) << text;
+  }
+  str = "!!str 25";
+  node = yaml_import.load(str);
+  EXPECT_EQ("25", node.stringValue());
+
+  // repeated scalars
+  node = yaml_import.load("[0.5, 1, 0.5, 1, abc, 0.5]");
+  EXPECT_EQ(Node(Sequence({0.5, 1, 0.5, 1, "abc", 0.5})), node);
+  EXPECT_TRUE(node[2].isFloat());
+  EXPECT_TRUE(node[3].isInt());
 }
 
 TEST(YAML, FileImport)
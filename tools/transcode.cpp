@@ -0,0 +1,71 @@
+/*
+ * transcode.cpp
+ * cpds
+ *
+ * Copyright (c) 2016 Hannes Friederich.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "cpds/exception.hpp"
+#include "cpds/transcode.hpp"
+
+// Converts between JSON and YAML, from a file or stdin to a file or stdout:
+//   cpds_transcode json2yaml|yaml2json [input [output]]
+
+int main(int argc, char** argv)
+{
+  if (argc < 2 || argc > 4 || (std::strcmp(argv[1], "json2yaml") != 0 &&
+                               std::strcmp(argv[1], "yaml2json") != 0))
+  {
+    std::cerr << "usage: " << argv[0]
+              << " json2yaml|yaml2json [input [output]]" << std::endl;
+    return 2;
+  }
+
+  std::ifstream fin;
+  if (argc > 2 && std::strcmp(argv[2], "-") != 0)
+  {
+    fin.open(argv[2]);
+    if (!fin)
+    {
+      std::cerr << "cannot open " << argv[2] << std::endl;
+      return 1;
+    }
+  }
+  std::ofstream fout;
+  if (argc > 3)
+  {
+    fout.open(argv[3]);
+    if (!fout)
+    {
+      std::cerr << "cannot open " << argv[3] << std::endl;
+      return 1;
+    }
+  }
+  std::istream& in = fin.is_open() ? fin : std::cin;
+  std::ostream& out = fout.is_open() ? fout : std::cout;
+
+  try
+  {
+    if (std::strcmp(argv[1], "json2yaml") == 0)
+    {
+      cpds::jsonToYaml(in, out);
+    }
+    else
+    {
+      cpds::yamlToJson(in, out);
+    }
+    out << std::endl;
+  }
+  catch (const cpds::Exception& e)
+  {
+    std::cerr << e << std::endl;
+    return 1;
+  }
+  return out.good() ? 0 : 1;
+}